@@ -0,0 +1,347 @@
+//
+//  main.cpp
+//  NE bench
+//
+//  Created by Arthur Sun on 9/30/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#include <cstdlib>
+#include <sstream>
+#include "../population.h"
+#include "../tasks.h"
+#include "../jit.h"
+
+// microbenchmarks of the hot paths, printed as one json object to diff between builds.
+// every measurement reseeds first, so two builds see the same genomes and the same episodes.
+// usage: NE_bench [seconds per measurement]
+
+static const uint64_t seed = 1;
+
+double min_time = 0.2;
+
+struct result {
+    std::string name;
+    std::string params;
+    size_t iterations;
+    double ns;
+};
+
+std::vector<result> results;
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// batch(n) does n operations from the same seeded start and returns the seconds spent in them.
+// n doubles until a batch takes min_time, and the fastest of three such batches is kept
+template <class F>
+void measure(const std::string& name, const std::string& params, F batch) {
+    size_t n = 1;
+    double t;
+    
+    while((t = batch(n)) < min_time && n < ((size_t)1 << 30))
+        n *= 2;
+    
+    for(int r = 0; r < 2; ++r)
+        t = std::min(t, batch(n));
+    
+    results.push_back({name, params, n, t * 1e9 / n});
+    std::cerr << name << " " << params << ": " << t * 1e9 / n << " ns" << '\n';
+}
+
+// hidden nodes and links between any two positions in order with probability density, all enabled
+void build(ne_genome& g, size_t hidden, double density) {
+    g.node_size += hidden;
+    
+    for(size_t j = g.input_size; j != g.node_size; ++j) {
+        for(size_t i = 0; i != j; ++i) {
+            if(i >= g.node_size - g.output_size || ne_random(0.0, 1.0) >= density) continue;
+            
+            ne_link link(g.id(i), g.id(j));
+            link.weight = ne_random(-2.0, 2.0);
+            g.add(link);
+        }
+    }
+}
+
+std::string format(const char* key, double value) {
+    std::ostringstream os;
+    os << ",\"" << key << "\":" << value;
+    return os.str();
+}
+
+// the exact networks again on code built for them, when there is a compiler
+void bench_activate() {
+    ne_jit jit;
+    
+    const size_t sizes[] = {0, 16, 64, 256};
+    const double densities[] = {0.1, 0.5};
+    
+    for(size_t hidden : sizes) {
+        for(double density : densities) {
+            for(ne_accuracy accuracy : {ne_exact, ne_fast}) {
+                ne_reseed(seed);
+                ne_genome g(8, 4);
+                build(g, hidden, density);
+                
+                ne_network network;
+                network.accuracy = accuracy;
+                network.compile(g);
+                
+                std::string params = format("hidden", hidden) + format("density", density) + format("links", g.links.size()) + format("fast", accuracy == ne_fast);
+                
+                measure("activate", params, [&] (size_t n) {
+                    network.flush();
+                    std::fill(network.inputs(), network.inputs() + g.input_size, 0.5);
+                    
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    
+                    for(size_t k = 0; k != n; ++k)
+                        network.activate();
+                    
+                    return seconds(start);
+                });
+                
+                if(accuracy == ne_exact && jit.compile_now(g)) {
+                    network.freeze(&jit.code);
+                    
+                    measure("activate_frozen", params, [&] (size_t n) {
+                        network.flush();
+                        std::fill(network.inputs(), network.inputs() + g.input_size, 0.5);
+                        
+                        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                        
+                        for(size_t k = 0; k != n; ++k)
+                            network.activate();
+                        
+                        return seconds(start);
+                    });
+                    
+                    network.freeze(nullptr);
+                }
+                
+                measure("compile", params, [&] (size_t n) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    
+                    for(size_t k = 0; k != n; ++k)
+                        network.compile(g);
+                    
+                    return seconds(start);
+                });
+            }
+        }
+    }
+}
+
+// copies share their blocks with base, so each mutation pays for unsharing one, as it does when breeding
+template <class F>
+void bench_mutation(const char* name, const ne_genome& base, const std::string& params, F mutate) {
+    measure(name, params, [&] (size_t n) {
+        ne_reseed(seed);
+        
+        double t = 0.0;
+        size_t chunk = 1024;
+        
+        std::vector<ne_genome> copies;
+        copies.reserve(chunk);
+        
+        for(size_t done = 0; done < n; done += chunk) {
+            size_t count = std::min(chunk, n - done);
+            
+            copies.clear();
+            for(size_t k = 0; k != count; ++k)
+                copies.emplace_back(base);
+            
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            
+            for(ne_genome& g : copies)
+                mutate(g);
+            
+            t += seconds(start);
+        }
+        
+        return t;
+    });
+}
+
+void bench_genome() {
+    const size_t sizes[] = {0, 16, 64, 256};
+    
+    for(size_t hidden : sizes) {
+        ne_reseed(seed);
+        ne_genome base(8, 4);
+        build(base, hidden, 0.2);
+        
+        std::string params = format("hidden", hidden) + format("links", base.links.size());
+        
+        measure("copy", params, [&] (size_t n) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            
+            for(size_t k = 0; k != n; ++k) {
+                ne_genome g(base);
+                (void)g;
+            }
+            
+            return seconds(start);
+        });
+        
+        bench_mutation("mutate_add_link", base, params, [] (ne_genome& g) {
+            g.mutate_add_link();
+        });
+        
+        bench_mutation("mutate_add_node", base, params, [] (ne_genome& g) {
+            g.mutate_add_node();
+        });
+    }
+}
+
+// populations of XOR shaped genomes, grown for a few generations on random fitness
+void bench_population() {
+    const size_t sizes[] = {100, 1000, 10000};
+    
+    for(size_t size : sizes) {
+        ne_reseed(seed);
+        
+        ne_settings settings(0.1, 0.0, size);
+        ne_population base(settings, XOR::input_size, XOR::output_size);
+        
+        for(int k = 0; k < 10; ++k) {
+            for(ne_genome* g : base.genomes)
+                g->fitness = ne_random(0.0, 1.0);
+            
+            base.analyse();
+            base.reproduce();
+        }
+        
+        for(ne_genome* g : base.genomes)
+            g->fitness = ne_random(0.0, 1.0);
+        
+        base.analyse();
+        
+        std::string params = format("population", size);
+        
+        measure("analyse", params, [&] (size_t n) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            
+            for(size_t k = 0; k != n; ++k)
+                base.analyse();
+            
+            return seconds(start);
+        });
+        
+        measure("reproduce", params, [&] (size_t n) {
+            double t = 0.0;
+            
+            for(size_t k = 0; k != n; ++k) {
+                ne_population p(base);
+                
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                p.reproduce();
+                t += seconds(start);
+            }
+            
+            return t;
+        });
+    }
+}
+
+void put32(std::ofstream& os, uint32_t v) {
+    unsigned char b[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v};
+    os.write((const char*)b, 4);
+}
+
+char digits[] = "/tmp/NE_bench.XXXXXX";
+
+// random 28x28 images with random labels, in a directory of their own so real data is never touched
+bool synthesize_digits() {
+    if(mkdtemp(digits) == nullptr || chdir(digits) != 0) return false;
+    
+    const uint32_t count = 1000;
+    const uint32_t side = 28;
+    
+    ne_reseed(seed);
+    
+    std::ofstream images("train-images-idx3-ubyte", std::ios::binary);
+    std::ofstream labels("train-labels-idx1-ubyte", std::ios::binary);
+    
+    put32(images, 0x00000803);
+    put32(images, count);
+    put32(images, side);
+    put32(images, side);
+    
+    put32(labels, 0x00000801);
+    put32(labels, count);
+    
+    for(size_t k = 0; k != (size_t)count * side * side; ++k)
+        images.put((char)ne_random(0, 255));
+    
+    for(size_t k = 0; k != count; ++k)
+        labels.put((char)ne_random(0, 9));
+    
+    return images.good() && labels.good();
+}
+
+// the mapping stays valid after the files are gone
+void remove_digits() {
+    unlink("train-images-idx3-ubyte");
+    unlink("train-labels-idx1-ubyte");
+    rmdir(digits);
+}
+
+template <class T>
+void bench_task() {
+    ne_reseed(seed);
+    
+    ne_genome g(T::input_size, T::output_size);
+    build(g, 16, 0.3);
+    
+    T task;
+    
+    measure("task", std::string(",\"task\":\"") + T::name() + "\"" + format("links", g.links.size()), [&] (size_t n) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        
+        for(size_t k = 0; k != n; ++k) {
+            ne_rng_scope scope(ne_stream(ne_evaluation_stream, 0, k));
+            task.run(&g, false);
+        }
+        
+        return seconds(start);
+    });
+}
+
+int main(int argc, const char * argv[]) {
+    if(argc > 1) min_time = atof(argv[1]);
+    
+    // the tasks print to std::cout when asked, which would corrupt the json
+    std::streambuf* out = std::cout.rdbuf(std::cerr.rdbuf());
+    
+    bench_activate();
+    bench_genome();
+    bench_population();
+    
+    bench_task<Pendulum>();
+    bench_task<XOR>();
+    bench_task<Game2048>();
+    bench_task<DIR>();
+    
+    if(synthesize_digits()) {
+        bench_task<HANDDIGITS>();
+        remove_digits();
+    }else{
+        std::cerr << "could not write synthetic digits, skipping HANDDIGITS" << '\n';
+    }
+    
+    std::cout.rdbuf(out);
+    
+    std::cout << "{\"seed\":" << seed << ",\"min_time\":" << min_time << ",\"results\":[";
+    
+    for(size_t k = 0; k != results.size(); ++k) {
+        const result& r = results[k];
+        std::cout << (k == 0 ? "" : ",") << "\n{\"name\":\"" << r.name << "\"" << r.params << ",\"iterations\":" << r.iterations << ",\"ns\":" << r.ns << "}";
+    }
+    
+    std::cout << "\n]}\n";
+    
+    return 0;
+}
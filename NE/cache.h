@@ -0,0 +1,56 @@
+//
+//  cache.h
+//  NE
+//
+//  Created by Arthur Sun on 9/21/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef cache_h
+#define cache_h
+
+#include "genome.h"
+
+// fitness of deterministic objectives by ne_genome::hash. entries live for two generations,
+// which covers children that came out of breed() computing the same function as their parent
+struct ne_fitness_cache {
+    typedef std::unordered_map<uint64_t, double> table_type;
+    
+    table_type current;
+    table_type previous;
+    
+    size_t hits;
+    size_t misses;
+    
+    ne_fitness_cache() : hits(0), misses(0) {}
+    
+    bool find(uint64_t key, double& fitness) {
+        table_type::iterator it = current.find(key);
+        
+        if(it == current.end()) {
+            it = previous.find(key);
+            
+            if(it == previous.end()) {
+                ++misses;
+                return false;
+            }
+            
+            current.insert(*it);
+        }
+        
+        ++hits;
+        fitness = it->second;
+        return true;
+    }
+    
+    void insert(uint64_t key, double fitness) {
+        current[key] = fitness;
+    }
+    
+    void next() {
+        previous.swap(current);
+        current.clear();
+    }
+};
+
+#endif /* cache_h */
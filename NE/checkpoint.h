@@ -0,0 +1,251 @@
+//
+//  checkpoint.h
+//  NE
+//
+//  Created by Arthur Sun on 9/24/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include "ne.h"
+#include <cassert>
+#include <string>
+
+// a checkpoint is a header of three words, magic, version and byte order, then records of 64-bit words:
+// the number of words, the words, and a checksum of them. words are stored in the byte order of the writer,
+// which the header records so a reader of the other order can swap them back
+
+static const uint64_t ne_checkpoint_magic = 0x74706b63454e; // "NEckpt" in little endian
+static const uint64_t ne_checkpoint_version = 6;
+static const uint64_t ne_byte_order = 0x0102030405060708;
+
+inline uint64_t ne_checksum(uint64_t h, uint64_t word) {
+    return (h ^ word) * 0x100000001b3;
+}
+
+// words taken by a string: its length, then its bytes eight to a word
+inline size_t ne_text_words(const std::string& s) {
+    return 1 + (s.size() + 7) / 8;
+}
+
+// to a file of its own or to any stream, such as a string being packed for another process
+struct ne_writer {
+    std::ofstream file;
+    std::ostream& os;
+    
+    std::vector<uint64_t> buffer;
+    size_t size;
+    
+    uint64_t checksum;
+    size_t left;
+    
+    ne_writer(const char* path) : file(path, std::ios::binary), os(file), buffer(1 << 13), size(0), left(0) {
+        header();
+    }
+    
+    ne_writer(std::ostream& stream) : os(stream), buffer(1 << 13), size(0), left(0) {
+        header();
+    }
+    
+    void header() {
+        raw(ne_checkpoint_magic);
+        raw(ne_checkpoint_version);
+        raw(ne_byte_order);
+    }
+    
+    ~ne_writer() {
+        flush();
+    }
+    
+    void raw(uint64_t w) {
+        if(size == buffer.size()) flush();
+        buffer[size++] = w;
+    }
+    
+    void flush() {
+        os.write((const char*)buffer.data(), size * sizeof(uint64_t));
+        size = 0;
+    }
+    
+    void begin(size_t words) {
+        assert(left == 0);
+        raw(words);
+        checksum = ne_mix(words);
+        left = words;
+    }
+    
+    void word(uint64_t w) {
+        assert(left != 0);
+        raw(w);
+        checksum = ne_checksum(checksum, w);
+        --left;
+    }
+    
+    void real(double d) {
+        uint64_t w;
+        memcpy(&w, &d, sizeof(w));
+        word(w);
+    }
+    
+    void text(const std::string& s) {
+        word(s.size());
+        
+        for(size_t k = 0; k < s.size(); k += 8) {
+            uint64_t w = 0;
+            memcpy(&w, s.data() + k, std::min((size_t)8, s.size() - k));
+            word(w);
+        }
+    }
+    
+    void end() {
+        assert(left == 0);
+        raw(ne_mix(checksum));
+    }
+    
+    bool close() {
+        flush();
+        if(file.is_open()) file.close();
+        return !os.fail();
+    }
+};
+
+struct ne_reader {
+    std::ifstream file;
+    std::istream& is;
+    
+    std::vector<uint64_t> buffer;
+    size_t size;
+    size_t next;
+    
+    bool swap;
+    bool good;
+    
+    uint64_t checksum;
+    size_t left;
+    
+    // words in the stream not read yet, or as many as can be when the stream can't tell
+    size_t remaining;
+    
+    ne_reader(const char* path) : file(path, std::ios::binary), is(file), buffer(1 << 13), size(0), next(0), swap(false), good(is.good()), left(0) {
+        header();
+    }
+    
+    ne_reader(std::istream& stream) : is(stream), buffer(1 << 13), size(0), next(0), swap(false), good(is.good()), left(0) {
+        header();
+    }
+    
+    void measure() {
+        remaining = ~(size_t)0;
+        
+        std::streampos here = is.tellg();
+        if(here == std::streampos(-1)) return;
+        
+        is.seekg(0, std::ios::end);
+        std::streampos end = is.tellg();
+        is.seekg(here);
+        
+        if(end != std::streampos(-1) && end >= here)
+            remaining = (size_t)(end - here) / sizeof(uint64_t);
+        
+        is.clear();
+    }
+    
+    void header() {
+        measure();
+        
+        uint64_t magic = raw();
+        uint64_t version = raw();
+        uint64_t order = raw();
+        
+        if(order == __builtin_bswap64(ne_byte_order)) {
+            swap = true;
+            magic = __builtin_bswap64(magic);
+            version = __builtin_bswap64(version);
+        }else if(order != ne_byte_order) {
+            good = false;
+        }
+        
+        if(magic != ne_checkpoint_magic || version != ne_checkpoint_version)
+            good = false;
+    }
+    
+    uint64_t raw() {
+        if(next == size) {
+            is.read((char*)buffer.data(), buffer.size() * sizeof(uint64_t));
+            size = is.gcount() / sizeof(uint64_t);
+            next = 0;
+            
+            if(size == 0) {
+                good = false;
+                return 0;
+            }
+        }
+        
+        if(remaining != 0) --remaining;
+        
+        uint64_t w = buffer[next++];
+        return swap ? __builtin_bswap64(w) : w;
+    }
+    
+    // the number of words in the record, zero and not good if there aren't that many left to read
+    size_t begin() {
+        left = raw();
+        checksum = ne_mix(left);
+        
+        if(left > remaining) {
+            good = false;
+            left = 0;
+        }
+        
+        return left;
+    }
+    
+    uint64_t word() {
+        if(left == 0) {
+            good = false;
+            return 0;
+        }
+        
+        uint64_t w = raw();
+        checksum = ne_checksum(checksum, w);
+        --left;
+        return w;
+    }
+    
+    double real() {
+        uint64_t w = word();
+        double d;
+        memcpy(&d, &w, sizeof(d));
+        return d;
+    }
+    
+    // fails the reader rather than read a string longer than what is left of the record
+    std::string text() {
+        size_t size = word();
+        
+        if(size > 8 * left) {
+            good = false;
+            return std::string();
+        }
+        
+        std::string s(size, '\0');
+        
+        for(size_t k = 0; k < size; k += 8) {
+            uint64_t w = word();
+            memcpy(&s[k], &w, std::min((size_t)8, size - k));
+        }
+        
+        return s;
+    }
+    
+    // false if the record was corrupt, short, or not read to its end
+    bool end() {
+        if(left != 0 || raw() != ne_mix(checksum))
+            good = false;
+        return good;
+    }
+};
+
+#endif /* checkpoint_h */
@@ -0,0 +1,126 @@
+//
+//  checkpointer.h
+//  NE
+//
+//  Created by Arthur Sun on 9/25/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef checkpointer_h
+#define checkpointer_h
+
+#include "population.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+
+// writes snapshots of a population on a thread of its own. save() only copies the current generation, which
+// shares its blocks, into the pending slot while the thread writes the other one; a snapshot still pending when
+// the next one arrives is dropped for it. files are written next to path and renamed over it when complete,
+// so path always holds the latest whole snapshot
+
+struct ne_checkpointer {
+    std::string path;
+    
+    struct snapshot {
+        ne_population* population;
+        ne_rng stream;
+        
+        snapshot() : population(nullptr) {}
+    };
+    
+    snapshot pending;
+    
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    
+    size_t written;
+    size_t dropped;
+    size_t failed;
+    bool quit;
+    
+    ne_checkpointer(const std::string& path) : path(path), written(0), dropped(0), failed(0), quit(false) {
+        thread = std::thread(&ne_checkpointer::loop, this);
+    }
+    
+    ne_checkpointer(const ne_checkpointer& checkpointer) = delete;
+    
+    ne_checkpointer& operator = (const ne_checkpointer& checkpointer) = delete;
+    
+    ~ne_checkpointer() {
+        close();
+    }
+    
+    // finishes the pending snapshot and stops the thread
+    void close() {
+        if(!thread.joinable()) return;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        
+        wake.notify_one();
+        thread.join();
+    }
+    
+    // snapshots population along with the calling thread's stream
+    void save(const ne_population& population) {
+        snapshot s;
+        s.population = new ne_population(population, ne_snapshot());
+        s.stream = ne_generator;
+        
+        ne_population* stale = nullptr;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stale = pending.population;
+            if(stale != nullptr) ++dropped;
+            pending = s;
+        }
+        
+        wake.notify_one();
+        delete stale;
+    }
+    
+    bool write(const snapshot& s) {
+        std::string temp = path + ".tmp";
+        
+        ne_writer w(temp.c_str());
+        s.population->write(w, s.stream);
+        
+        if(!w.close()) return false;
+        
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+    
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        while(true) {
+            wake.wait(lock, [this] {
+                return quit || pending.population != nullptr;
+            });
+            
+            if(pending.population == nullptr) return;
+            
+            snapshot s = pending;
+            pending.population = nullptr;
+            
+            lock.unlock();
+            bool ok = write(s);
+            delete s.population;
+            lock.lock();
+            
+            if(ok) {
+                ++written;
+            }else{
+                ++failed;
+            }
+        }
+    }
+};
+
+#endif /* checkpointer_h */
@@ -0,0 +1,150 @@
+//
+//  dataset.h
+//  NE
+//
+//  Created by Arthur Sun on 9/20/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef dataset_h
+#define dataset_h
+
+#include <vector>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// read-only mapping of a whole file
+struct ne_mapped_file {
+    const unsigned char* data;
+    size_t size;
+    
+    ne_mapped_file() : data(nullptr), size(0) {}
+    
+    ne_mapped_file(const ne_mapped_file& file) = delete;
+    
+    ne_mapped_file& operator = (const ne_mapped_file& file) = delete;
+    
+    ~ne_mapped_file() {
+        close();
+    }
+    
+    bool open(const char* path) {
+        close();
+        
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0) return false;
+        
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        
+        if(p == MAP_FAILED) return false;
+        
+        data = (const unsigned char*)p;
+        size = st.st_size;
+        return true;
+    }
+    
+    void close() {
+        if(data != nullptr) munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+    }
+};
+
+// IDX file of unsigned bytes: 0x00 0x00 0x08 rank, then rank big-endian uint32 dimensions, then the values
+struct ne_idx {
+    ne_mapped_file file;
+    
+    std::vector<size_t> dims;
+    const unsigned char* values;
+    
+    ne_idx() : values(nullptr) {}
+    
+    bool open(const char* path, size_t rank) {
+        dims.clear();
+        values = nullptr;
+        
+        if(!file.open(path)) return false;
+        
+        const unsigned char* p = file.data;
+        size_t header = 4 + 4 * rank;
+        
+        if(file.size < header || p[0] != 0 || p[1] != 0 || p[2] != 0x08 || p[3] != rank) return false;
+        
+        size_t total = 1;
+        for(size_t k = 0; k != rank; ++k) {
+            const unsigned char* d = p + 4 + 4 * k;
+            dims.push_back(((size_t)d[0] << 24) | ((size_t)d[1] << 16) | ((size_t)d[2] << 8) | (size_t)d[3]);
+            total *= dims.back();
+        }
+        
+        if(file.size - header < total) return false;
+        
+        values = p + header;
+        return true;
+    }
+    
+    size_t count() const {
+        return dims.empty() ? 0 : dims[0];
+    }
+};
+
+// images and labels of an MNIST style pair of files, as zero-copy views.
+// pixels come out divided by 256, through a lookup table
+struct ne_dataset {
+    ne_idx images;
+    ne_idx labels;
+    
+    size_t count;
+    size_t width;
+    size_t height;
+    
+    double scale[256];
+    
+    ne_dataset() : count(0), width(0), height(0) {
+        for(int i = 0; i < 256; ++i)
+            scale[i] = i / 0x1p8;
+    }
+    
+    bool open(const char* image_path, const char* label_path) {
+        if(!images.open(image_path, 3) || !labels.open(label_path, 1)) return false;
+        if(images.count() != labels.count()) return false;
+        
+        count = images.count();
+        height = images.dims[1];
+        width = images.dims[2];
+        return true;
+    }
+    
+    size_t pixels() const {
+        return width * height;
+    }
+    
+    const unsigned char* image(size_t i) const {
+        return images.values + i * pixels();
+    }
+    
+    unsigned char label(size_t i) const {
+        return labels.values[i];
+    }
+    
+    // pixel k of image i goes to inputs[k * stride]
+    void load(size_t i, double* inputs, size_t stride) const {
+        size_t q = pixels();
+        const unsigned char* c = image(i);
+        
+        for(size_t k = 0; k != q; ++k)
+            inputs[k * stride] = scale[c[k]];
+    }
+};
+
+#endif /* dataset_h */
@@ -0,0 +1,578 @@
+//
+//  farm.h
+//  NE
+//
+//  Created by Arthur Sun on 9/29/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef farm_h
+#define farm_h
+
+#include "task.h"
+#include <sstream>
+#include <deque>
+#include <cerrno>
+#include <string>
+#include <chrono>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// evaluation in worker processes that speak over a pair of pipes. every message is its length in bytes
+// followed by a checkpoint stream. the first message to a worker holds the seed and the accuracy, and the
+// worker answers it with the task's input and output sizes once it is ready. after that each message is a
+// batch: a record with the generation and the index of every genome in it, then the genomes. the worker
+// answers each batch with one record of the indices and their fitness, in order. a length past the limit
+// can only be garbage
+
+static const uint64_t ne_message_limit = (uint64_t)1 << 30;
+
+inline bool ne_write_all(int fd, const char* data, size_t size) {
+    while(size != 0) {
+        ssize_t n = write(fd, data, size);
+        
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        
+        data += n;
+        size -= n;
+    }
+    
+    return true;
+}
+
+inline bool ne_read_all(int fd, char* data, size_t size) {
+    while(size != 0) {
+        ssize_t n = read(fd, data, size);
+        
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        
+        data += n;
+        size -= n;
+    }
+    
+    return true;
+}
+
+inline void ne_append_message(std::string& buffer, const std::string& message) {
+    uint64_t size = message.size();
+    buffer.append((const char*)&size, sizeof(size));
+    buffer.append(message);
+}
+
+inline bool ne_write_message(int fd, const std::string& message) {
+    std::string buffer;
+    ne_append_message(buffer, message);
+    return ne_write_all(fd, buffer.data(), buffer.size());
+}
+
+inline bool ne_read_message(int fd, std::string& message) {
+    uint64_t size;
+    if(!ne_read_all(fd, (char*)&size, sizeof(size)) || size > ne_message_limit) return false;
+    
+    message.resize(size);
+    return ne_read_all(fd, &message[0], size);
+}
+
+// the worker's side: answers batches on in and out with the registered task called name until in closes
+inline int ne_serve(const std::string& name, int in, int out) {
+    std::string message;
+    
+    if(!ne_read_message(in, message)) return 1;
+    
+    {
+        std::istringstream is(message);
+        ne_reader r(is);
+        
+        if(r.begin() != 2) return 1;
+        uint64_t seed = r.word();
+        ne_accuracy accuracy = (ne_accuracy)r.word();
+        if(!r.end()) return 1;
+        
+        ne_reseed(seed);
+        ne_default_accuracy() = accuracy;
+    }
+    
+    // after the accuracy is set, which the task's networks take when they are made
+    std::unique_ptr<ne_task> task(ne_make_task(name));
+    if(task == nullptr) return 1;
+    
+    {
+        std::ostringstream os;
+        ne_writer w(os);
+        w.begin(2);
+        w.word(task->input_size());
+        w.word(task->output_size());
+        w.end();
+        w.close();
+        
+        if(!ne_write_message(out, os.str())) return 1;
+    }
+    
+    std::vector<size_t> indices;
+    std::vector<double> fitnesses;
+    
+    while(ne_read_message(in, message)) {
+        std::istringstream is(message);
+        ne_reader r(is);
+        
+        size_t words = r.begin();
+        if(words < 1) return 1;
+        
+        uint64_t n = r.word();
+        indices.resize(words - 1);
+        
+        for(size_t& i : indices)
+            i = r.word();
+        
+        if(!r.end()) return 1;
+        
+        fitnesses.resize(indices.size());
+        
+        for(size_t k = 0; k != indices.size(); ++k) {
+            ne_genome g(r);
+            if(!r.good || g.input_size != task->input_size() || g.output_size != task->output_size()) return 1;
+            
+            ne_rng_scope scope(ne_stream(ne_evaluation_stream, n, indices[k]));
+            fitnesses[k] = task->evaluate(&g, false);
+        }
+        
+        std::ostringstream os;
+        
+        {
+            ne_writer w(os);
+            w.begin(2 * indices.size());
+            
+            for(size_t k = 0; k != indices.size(); ++k) {
+                w.word(indices[k]);
+                w.real(fitnesses[k]);
+            }
+            
+            w.end();
+            w.close();
+        }
+        
+        if(!ne_write_message(out, os.str())) return 1;
+    }
+    
+    return 0;
+}
+
+// the master's side: keeps depth batches in flight on every worker, so each has its next batch waiting
+// while it runs one. its ends of the pipes don't block: what a worker hasn't taken of its batches yet, and
+// what has come of its answer so far, wait in buffers of its own, so a slow worker holds up neither the
+// others nor the timeout. a worker that dies, answers garbage or takes longer than timeout over a batch is
+// restarted and its batches go to the front of the queue; a batch that has taken down attempts workers
+// is given up on with zero fitness. a worker that can't be started, or doesn't say it is ready within
+// timeout, leaves the farm not good, since every worker after it would fail the same way
+struct ne_farm {
+    typedef std::chrono::steady_clock clock;
+    
+    static const size_t depth = 2;
+    static const size_t attempts = 3;
+    
+    struct worker {
+        pid_t pid;
+        int in;
+        int out;
+        
+        std::deque<size_t> batches;
+        
+        // messages not yet written, of which the first sent bytes are, and bytes read but not yet answered
+        std::string sending;
+        size_t sent;
+        std::string received;
+        
+        // when the worker started on the first of its batches
+        clock::time_point since;
+        
+        worker() : pid(-1), in(-1), out(-1), sent(0) {}
+    };
+    
+    struct batch {
+        std::vector<size_t> indices;
+        std::string message;
+        size_t failures;
+    };
+    
+    std::string command;
+    std::string task;
+    
+    uint64_t seed;
+    ne_accuracy accuracy;
+    
+    // genomes per batch
+    size_t size;
+    
+    std::vector<worker> workers;
+    
+    // milliseconds a worker has to get ready or to answer a batch
+    int timeout;
+    
+    size_t restarts;
+    size_t failed;
+    
+    // every worker is up
+    bool good;
+    
+    ne_farm(const std::string& command, const std::string& task, size_t count, size_t size, uint64_t seed, ne_accuracy accuracy) : command(command), task(task), seed(seed), accuracy(accuracy), size(size == 0 ? 1 : size), workers(count == 0 ? 1 : count), timeout(120 * 1000), restarts(0), failed(0), good(access(command.c_str(), X_OK) == 0) {
+        signal(SIGPIPE, SIG_IGN);
+        
+        for(worker& w : workers) {
+            if(good) good = spawn(w);
+        }
+    }
+    
+    ne_farm(const ne_farm& farm) = delete;
+    
+    ne_farm& operator = (const ne_farm& farm) = delete;
+    
+    ~ne_farm() {
+        for(worker& w : workers)
+            stop(w);
+    }
+    
+    // starts w and waits for it to be ready, false and w stopped if it isn't
+    bool spawn(worker& w) {
+        int down[2];
+        int up[2];
+        
+        if(pipe(down) != 0) return false;
+        
+        if(pipe(up) != 0) {
+            close(down[0]);
+            close(down[1]);
+            return false;
+        }
+        
+        // the master's ends must not leak into workers started later, or their pipes never see end of file
+        fcntl(down[1], F_SETFD, FD_CLOEXEC);
+        fcntl(up[0], F_SETFD, FD_CLOEXEC);
+        fcntl(down[1], F_SETFL, fcntl(down[1], F_GETFL) | O_NONBLOCK);
+        fcntl(up[0], F_SETFL, fcntl(up[0], F_GETFL) | O_NONBLOCK);
+        
+        w.pid = fork();
+        
+        if(w.pid < 0) {
+            close(down[0]);
+            close(down[1]);
+            close(up[0]);
+            close(up[1]);
+            return false;
+        }
+        
+        if(w.pid == 0) {
+            dup2(down[0], 0);
+            dup2(up[1], 1);
+            close(down[0]);
+            close(down[1]);
+            close(up[0]);
+            close(up[1]);
+            execl(command.c_str(), command.c_str(), task.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+        
+        close(down[0]);
+        close(up[1]);
+        w.in = down[1];
+        w.out = up[0];
+        
+        std::ostringstream os;
+        
+        {
+            ne_writer writer(os);
+            writer.begin(2);
+            writer.word(seed);
+            writer.word(accuracy);
+            writer.end();
+            writer.close();
+        }
+        
+        ne_append_message(w.sending, os.str());
+        
+        clock::time_point deadline = clock::now() + std::chrono::milliseconds(timeout);
+        std::string message;
+        
+        while(!receive(w, message)) {
+            pollfd fds[2] = {{w.out, POLLIN, 0}, {w.sent == w.sending.size() ? -1 : w.in, POLLOUT, 0}};
+            int wait = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+            
+            if(wait <= 0) {
+                stop(w);
+                return false;
+            }
+            
+            if(poll(fds, 2, wait) < 0) continue;
+            
+            if((fds[1].revents != 0 && !flush(w)) || (fds[0].revents != 0 && !fill(w))) {
+                stop(w);
+                return false;
+            }
+        }
+        
+        std::istringstream is(message);
+        ne_reader r(is);
+        
+        if(r.begin() != 2) {
+            stop(w);
+            return false;
+        }
+        
+        r.word();
+        r.word();
+        
+        if(!r.end()) {
+            stop(w);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    void stop(worker& w) {
+        if(w.in != -1) close(w.in);
+        if(w.out != -1) close(w.out);
+        
+        if(w.pid > 0) {
+            kill(w.pid, SIGKILL);
+            waitpid(w.pid, nullptr, 0);
+        }
+        
+        w.pid = -1;
+        w.in = -1;
+        w.out = -1;
+        
+        w.sending.clear();
+        w.sent = 0;
+        w.received.clear();
+    }
+    
+    // writes what the pipe to w will take of its unsent messages, false if the pipe is broken
+    bool flush(worker& w) {
+        while(w.sent != w.sending.size()) {
+            ssize_t n = write(w.in, w.sending.data() + w.sent, w.sending.size() - w.sent);
+            
+            if(n < 0) {
+                if(errno == EINTR) continue;
+                if(errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                return false;
+            }
+            
+            w.sent += n;
+        }
+        
+        w.sending.clear();
+        w.sent = 0;
+        return true;
+    }
+    
+    // reads what poll said w has written, false once it has closed its end or begun a message longer than
+    // the limit
+    bool fill(worker& w) {
+        char data[1 << 16];
+        ssize_t n;
+        
+        do {
+            n = read(w.out, data, sizeof(data));
+        }while(n < 0 && errno == EINTR);
+        
+        if(n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        if(n == 0) return false;
+        
+        w.received.append(data, n);
+        
+        uint64_t size;
+        
+        if(w.received.size() >= sizeof(size)) {
+            memcpy(&size, w.received.data(), sizeof(size));
+            if(size > ne_message_limit) return false;
+        }
+        
+        return true;
+    }
+    
+    // takes the first whole message w has sent, false if it hasn't finished one yet
+    bool receive(worker& w, std::string& message) {
+        uint64_t size;
+        
+        if(w.received.size() < sizeof(size)) return false;
+        memcpy(&size, w.received.data(), sizeof(size));
+        
+        if(w.received.size() - sizeof(size) < size) return false;
+        
+        message.assign(w.received, sizeof(size), size);
+        w.received.erase(0, sizeof(size) + size);
+        return true;
+    }
+    
+    // fitness of genomes[i] for every i in pending, with the streams of generation n. false, with some
+    // left unevaluated, once a worker can't be restarted
+    bool evaluate(size_t n, const std::vector<ne_genome*>& genomes, const std::vector<size_t>& pending) {
+        std::vector<batch> batches((pending.size() + size - 1) / size);
+        std::deque<size_t> queue;
+        
+        for(size_t b = 0; b != batches.size(); ++b) {
+            batch& q = batches[b];
+            q.indices.assign(pending.begin() + b * size, pending.begin() + std::min(pending.size(), (b + 1) * size));
+            q.failures = 0;
+            
+            std::ostringstream os;
+            
+            {
+                ne_writer w(os);
+                w.begin(1 + q.indices.size());
+                w.word(n);
+                
+                for(size_t i : q.indices)
+                    w.word(i);
+                
+                w.end();
+                
+                for(size_t i : q.indices)
+                    genomes[i]->write(w);
+                
+                w.close();
+            }
+            
+            q.message = os.str();
+            queue.push_back(b);
+        }
+        
+        size_t done = 0;
+        
+        // what comes back from each worker, then the way to it while it has something left to take
+        std::vector<pollfd> fds(2 * workers.size());
+        std::string message;
+        
+        while(done != batches.size()) {
+            if(!good) return false;
+            
+            for(worker& w : workers) {
+                while(w.batches.size() < depth && !queue.empty()) {
+                    size_t b = queue.front();
+                    queue.pop_front();
+                    
+                    if(w.batches.empty()) w.since = clock::now();
+                    w.batches.push_back(b);
+                    
+                    ne_append_message(w.sending, batches[b].message);
+                }
+            }
+            
+            size_t busy = 0;
+            
+            clock::time_point now = clock::now();
+            clock::time_point deadline = now + std::chrono::milliseconds(timeout);
+            
+            for(size_t k = 0; k != workers.size(); ++k) {
+                const worker& w = workers[k];
+                
+                fds[2 * k].fd = w.batches.empty() ? -1 : w.out;
+                fds[2 * k].events = POLLIN;
+                fds[2 * k].revents = 0;
+                
+                fds[2 * k + 1].fd = w.sent == w.sending.size() ? -1 : w.in;
+                fds[2 * k + 1].events = POLLOUT;
+                fds[2 * k + 1].revents = 0;
+                
+                if(w.batches.empty()) continue;
+                
+                deadline = std::min(deadline, w.since + std::chrono::milliseconds(timeout));
+                ++busy;
+            }
+            
+            // every worker died taking its batch, those left are back in the queue
+            if(busy == 0) continue;
+            
+            int wait = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+            if(poll(fds.data(), fds.size(), std::max(wait, 0)) < 0) continue;
+            
+            now = clock::now();
+            
+            for(size_t k = 0; k != workers.size(); ++k) {
+                worker& w = workers[k];
+                
+                if(w.batches.empty()) continue;
+                
+                if((fds[2 * k + 1].revents != 0 && !flush(w)) || (fds[2 * k].revents != 0 && !fill(w))) {
+                    done += crash(w, batches, queue, genomes);
+                    continue;
+                }
+                
+                bool answered = true;
+                
+                while(!w.batches.empty() && receive(w, message)) {
+                    if(!answer(message, batches[w.batches.front()], genomes)) {
+                        answered = false;
+                        break;
+                    }
+                    
+                    w.batches.pop_front();
+                    w.since = now;
+                    ++done;
+                }
+                
+                // a worker that has gone quiet for too long, in the middle of a message or not, is as good as dead
+                if(!answered || (!w.batches.empty() && now - w.since >= std::chrono::milliseconds(timeout)))
+                    done += crash(w, batches, queue, genomes);
+            }
+        }
+        
+        return true;
+    }
+    
+    bool answer(const std::string& message, const batch& q, const std::vector<ne_genome*>& genomes) {
+        std::istringstream is(message);
+        ne_reader r(is);
+        
+        if(r.begin() != 2 * q.indices.size()) return false;
+        
+        std::vector<double> fitnesses(q.indices.size());
+        
+        for(size_t k = 0; k != q.indices.size(); ++k) {
+            if(r.word() != q.indices[k]) return false;
+            fitnesses[k] = r.real();
+        }
+        
+        if(!r.end()) return false;
+        
+        for(size_t k = 0; k != q.indices.size(); ++k)
+            genomes[q.indices[k]]->fitness = fitnesses[k];
+        
+        return true;
+    }
+    
+    // restarts w and requeues its batches, returns how many were given up on
+    size_t crash(worker& w, std::vector<batch>& batches, std::deque<size_t>& queue, const std::vector<ne_genome*>& genomes) {
+        size_t given = 0;
+        
+        while(!w.batches.empty()) {
+            size_t b = w.batches.back();
+            w.batches.pop_back();
+            
+            if(++batches[b].failures == attempts) {
+                for(size_t i : batches[b].indices)
+                    genomes[i]->fitness = 0.0;
+                
+                ++failed;
+                ++given;
+            }else{
+                queue.push_front(b);
+            }
+        }
+        
+        stop(w);
+        if(!spawn(w)) good = false;
+        ++restarts;
+        
+        return given;
+    }
+};
+
+#endif /* farm_h */
@@ -9,150 +9,308 @@
 #ifndef genome_h
 #define genome_h
 
-#include "ne.h"
+#include "checkpoint.h"
+
+// what a compaction pass removed
+struct ne_compaction {
+    size_t links;
+    size_t nodes;
+    
+    ne_compaction() : links(0), nodes(0) {}
+    
+    ne_compaction& operator += (const ne_compaction& c) {
+        links += c.links;
+        nodes += c.nodes;
+        return *this;
+    }
+};
+
+// links refer to nodes by id: inputs, then outputs, then hidden nodes in the order they were added,
+// so adding a node never renumbers anything. nodes are activated in position order: inputs, hidden, outputs
 
 struct ne_genome {
     double fitness;
     
-    std::vector<ne_node*> nodes;
-    std::vector<ne_link*> links;
+    // index of the population's species this genome, or the genome it was copied from, last fell in
+    size_t species;
     
-    ne_link_set link_set;
+    ne_link_array links;
     
     size_t input_size;
     size_t output_size;
+    size_t node_size;
     
-    ne_genome(const ne_genome& genome) : input_size(genome.input_size), output_size(genome.output_size) {
-        size_t size = genome.nodes.size();
-        nodes.resize(size);
-        for(size_t i = 0; i != size; ++i) {
-            nodes[i] = new ne_node();
-            genome.nodes[i]->clone = i;
-        }
-        
-        for(ne_link* link : genome.links) {
-            if(link->weight == 0.0) continue;
-            ne_link* clone = new ne_link(nodes[link->i->clone], nodes[link->j->clone]);
-            clone->weight = link->weight;
-            add(clone);
-        }
-    }
+    // links with a zero weight
+    size_t disabled;
     
-    ne_genome(size_t input_size, size_t output_size) : input_size(input_size), output_size(output_size) {
-        nodes.resize(input_size + output_size);
-        
-        for(ne_node*& node : nodes)
-            node = new ne_node();
+    ne_genome(const ne_genome& genome) {
+        copy(genome);
     }
     
-    ne_genome(std::ifstream& is) {
-        size_t q;
-        is.read((char*)&q, sizeof(q));
-        nodes.resize(q);
-        is.read((char*)&q, sizeof(q));
-        links.resize(q);
-        size_t i, j;
-        for(ne_link* link : links) {
-            is.read((char*)&i, sizeof(i));
-            is.read((char*)&j, sizeof(j));
-            is.read((char*)&link->weight, sizeof(link->weight));
+    ne_genome(size_t input_size, size_t output_size) : species(0), input_size(input_size), output_size(output_size), node_size(input_size + output_size), disabled(0) {}
+    
+    ne_genome(ne_reader& r) : disabled(0) {
+        size_t words = r.begin();
+        
+        input_size = r.word();
+        output_size = r.word();
+        node_size = r.word();
+        fitness = r.real();
+        species = r.word();
+        
+        size_t count = r.word();
+        
+        // genomes also come off sockets and pipes, so nothing read may point a network outside its nodes:
+        // inputs and outputs fit in the nodes, ids fit in a key, and links join existing nodes into a non-input
+        if(words < 6 || count != (words - 6) / 3 || words != 6 + 3 * count || input_size > node_size || output_size > node_size - input_size || node_size > ((uint64_t)1 << 32)) {
+            r.good = false;
+            return;
+        }
+        
+        links.reserve(count);
+        
+        ne_link link;
+        for(size_t n = 0; n != count; ++n) {
+            link.i = r.word();
+            link.j = r.word();
+            link.weight = r.real();
             
-            link->i = nodes[i];
-            link->j = nodes[j];
+            if(link.i >= node_size || link.j >= node_size || link.j < input_size) {
+                r.good = false;
+                return;
+            }
             
-            link_set.insert(link);
-            link->j->links.push_back(link);
+            add(link);
         }
+        
+        r.end();
     }
     
     ne_genome& operator = (const ne_genome& genome) = delete;
     
-    ~ne_genome() {
-        for(ne_link* link : links)
-            delete link;
+    // shares every block with genome, unless genome has disabled links to leave behind
+    ne_genome* copy(const ne_genome& genome) {
+        input_size = genome.input_size;
+        output_size = genome.output_size;
+        node_size = genome.node_size;
+        species = genome.species;
+        disabled = 0;
+        
+        if(genome.disabled == 0) {
+            links = genome.links;
+            return this;
+        }
+        
+        links.clear();
+        links.reserve(genome.links.size());
         
-        for(ne_node* node : nodes)
-            delete node;
+        for(const ne_link& link : genome.links) {
+            if(link.weight == 0.0) continue;
+            add(link);
+        }
+        
+        return this;
+    }
+    
+    // the same links as genome, dead ones included, sharing every block
+    ne_genome* share(const ne_genome& genome) {
+        fitness = genome.fitness;
+        species = genome.species;
+        links = genome.links;
+        input_size = genome.input_size;
+        output_size = genome.output_size;
+        node_size = genome.node_size;
+        disabled = genome.disabled;
+        return this;
     }
     
-    ne_node** inputs() {
-        return nodes.data();
+    size_t position(size_t id) const {
+        if(id < input_size) return id;
+        if(id < input_size + output_size) return node_size - output_size + (id - input_size);
+        return id - output_size;
     }
     
-    ne_node** outputs() {
-        return nodes.data() + nodes.size() - output_size;
+    size_t id(size_t position) const {
+        if(position < input_size) return position;
+        if(position >= node_size - output_size) return input_size + (position - (node_size - output_size));
+        return position + output_size;
     }
     
-    void flush() {
-        size_t size = nodes.size();
+    void mutate_add_node() {
+        size_t k = ne_random(0lu, links.size() - 1);
+        
+        if(links[k].weight == 0.0) return;
+        
+        size_t node = node_size++;
+        
+        ne_link link1(links[k].i, node);
+        link1.weight = 1.0;
+        
+        ne_link link2(node, links[k].j);
+        link2.weight = links[k].weight;
         
-        for(size_t i = input_size; i != size; ++i) {
-            nodes[i]->value = 0.0;
+        links.write(k).weight = 0.0;
+        ++disabled;
+        
+        add(link1);
+        add(link2);
+    }
+    
+    void mutate_add_link() {
+        size_t size = node_size - 1;
+        
+        size_t j = ne_random(input_size, size);
+        size_t i = ne_random(0lu, size - output_size);
+        
+        ne_link q(id(i), id(j));
+        
+        size_t k = links.find(q.key());
+        if(k != ne_link_array::npos) {
+            if(links[k].weight == 0.0) {
+                links.write(k).weight = ne_random(-2.0, 2.0);
+                --disabled;
+            }
+        }else{
+            q.weight = ne_random(-2.0, 2.0);
+            add(q);
         }
     }
     
-    void activate() {
-        size_t size = nodes.size();
+    // fed: reachable from an input through enabled links. useful: reaches an output through them
+    void reach(std::vector<char>& fed, std::vector<char>& useful) const {
+        fed.assign(node_size, 0);
+        useful.assign(node_size, 0);
         
-        for(size_t i = input_size; i != size; ++i) {
-            double sum = 0.0;
-            
-            for(ne_link* link : nodes[i]->links)
-                sum += link->weight * link->i->value;
+        std::fill(fed.begin(), fed.begin() + input_size, 1);
+        std::fill(useful.begin() + input_size, useful.begin() + input_size + output_size, 1);
+        
+        bool changed = true;
+        while(changed) {
+            changed = false;
             
-            nodes[i]->value = tanh(sum);
+            for(const ne_link& link : links) {
+                if(link.weight == 0.0) continue;
+                
+                if(fed[link.i] && !fed[link.j]) {
+                    fed[link.j] = 1;
+                    changed = true;
+                }
+                
+                if(useful[link.j] && !useful[link.i]) {
+                    useful[link.i] = 1;
+                    changed = true;
+                }
+            }
         }
     }
     
-    void mutate_add_node() {
-        ne_link* link = links[ne_random(0lu, links.size() - 1)];
+    // marks the links that can change an output: enabled, leaving an input or a node fed by such a link,
+    // and entering an output or a node that leads to one. the rest only ever add zero
+    void effective(std::vector<char>& live) const {
+        std::vector<char> fed, useful;
+        reach(fed, useful);
         
-        if(link->weight == 0.0 || link->i == 0) return;
+        size_t size = links.size();
+        live.resize(size);
         
-        ne_node* node = new ne_node();
-        nodes.insert(nodes.end() - output_size, node);
+        for(size_t k = 0; k != size; ++k)
+            live[k] = links[k].weight != 0.0 && fed[links[k].i] && useful[links[k].j];
+    }
+    
+    // equal for genomes with the same effective links and weights, whatever their order or dead structure
+    uint64_t hash() const {
+        std::vector<char> live;
+        effective(live);
         
-        ne_link* link1 = new ne_link(link->i, node);
-        link1->weight = 1.0;
-        add(link1);
+        uint64_t h = ne_mix(ne_mix(input_size) ^ output_size);
         
-        ne_link* link2 = new ne_link(node, link->j);
-        link2->weight = link->weight;
-        add(link2);
+        for(size_t k = 0; k != links.size(); ++k) {
+            if(!live[k]) continue;
+            
+            uint64_t bits;
+            memcpy(&bits, &links[k].weight, sizeof(bits));
+            h += ne_mix(links[k].key() ^ ne_mix(bits));
+        }
         
-        link->weight = 0.0;
+        return h;
     }
     
-    void mutate_add_link() {
-        size_t size = nodes.size() - 1;
+    // drops disabled links and the hidden nodes that cannot both be reached from an input and reach an output,
+    // renumbering the remaining hidden nodes in order. what is left is exactly the effective structure
+    ne_compaction compact() {
+        ne_compaction pruned;
+        
+        std::vector<char> fed, useful;
+        reach(fed, useful);
         
-        ne_link q(nodes[ne_random(0lu, size - output_size)], nodes[ne_random(input_size, size)]);
+        size_t first = input_size + output_size;
         
-        ne_link_set::iterator it = link_set.find(&q);
-        if(it != link_set.end()) {
-            if((*it)->weight == 0.0) {
-                (*it)->weight = ne_random(-2.0, 2.0);
+        std::vector<size_t> ids(node_size);
+        size_t size = first;
+        
+        for(size_t n = 0; n != node_size; ++n) {
+            if(n < first) {
+                ids[n] = n;
+            }else if(fed[n] && useful[n]) {
+                ids[n] = size++;
+            }else{
+                ids[n] = ne_link_array::npos;
             }
-        }else{
-            ne_link* link = new ne_link(q);
-            link->weight = ne_random(-2.0, 2.0);
-            add(link);
         }
+        
+        pruned.nodes = node_size - size;
+        
+        for(const ne_link& link : links) {
+            if(link.weight == 0.0 || ids[link.i] == ne_link_array::npos || ids[link.j] == ne_link_array::npos)
+                ++pruned.links;
+        }
+        
+        // leave shared blocks alone when there is nothing to drop
+        if(pruned.links == 0 && pruned.nodes == 0)
+            return pruned;
+        
+        ne_link_array live;
+        live.reserve(links.size() - pruned.links);
+        
+        for(const ne_link& link : links) {
+            if(link.weight == 0.0 || ids[link.i] == ne_link_array::npos || ids[link.j] == ne_link_array::npos)
+                continue;
+            
+            ne_link q(ids[link.i], ids[link.j]);
+            q.weight = link.weight;
+            live.push_back(q);
+        }
+        
+        links = std::move(live);
+        node_size = size;
+        disabled = 0;
+        
+        return pruned;
     }
     
-    void adapt(double rate) {
-        for(ne_link* link : links)
-            link->weight += rate * link->i->value * link->j->value;
+    // values indexed by position, as laid out by ne_network
+    void adapt(double rate, const double* values) {
+        disabled = 0;
+        
+        for(size_t k = 0; k != links.size(); ++k) {
+            ne_link& link = links.write(k);
+            link.weight += rate * values[position(link.i)] * values[position(link.j)];
+            if(link.weight == 0.0) ++disabled;
+        }
     }
     
     void mutate_weight() {
-        links[ne_random(0lu, links.size() - 1)]->weight += ne_random(-2.0, 2.0);
+        double delta = ne_random(-2.0, 2.0);
+        ne_link& link = links.write(ne_random(0lu, links.size() - 1));
+        
+        if(link.weight == 0.0) --disabled;
+        link.weight += delta;
+        if(link.weight == 0.0) ++disabled;
     }
     
-    void add(ne_link* link) {
+    void add(const ne_link& link) {
         links.push_back(link);
-        link_set.insert(link);
-        link->j->links.push_back(link);
+        if(link.weight == 0.0) ++disabled;
     }
     
     void mutate(double mutate_add_prob) {
@@ -164,22 +322,23 @@ struct ne_genome {
         mutate_add_link();
     }
     
-    void write(std::ofstream& os) const {
-        size_t q;
-        q = nodes.size();
-        os.write((char*)&q, sizeof(q));
+    void write(ne_writer& w) const {
+        w.begin(6 + 3 * links.size());
         
-        for(size_t i = 0; i < q; ++i)
-            nodes[i]->clone = i;
+        w.word(input_size);
+        w.word(output_size);
+        w.word(node_size);
+        w.real(fitness);
+        w.word(species);
+        w.word(links.size());
         
-        q = links.size();
-        os.write((char*)&q, sizeof(q));
-        
-        for(ne_link* link : links) {
-            os.write((char*)&link->i->clone, sizeof(link->i->clone));
-            os.write((char*)&link->j->clone, sizeof(link->j->clone));
-            os.write((char*)&link->weight, sizeof(link->weight));
+        for(const ne_link& link : links) {
+            w.word(link.i);
+            w.word(link.j);
+            w.real(link.weight);
         }
+        
+        w.end();
     }
 };
 
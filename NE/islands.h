@@ -0,0 +1,211 @@
+//
+//  islands.h
+//  NE
+//
+//  Created by Arthur Sun on 9/28/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef islands_h
+#define islands_h
+
+#include "population.h"
+#include <sstream>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// migrants travel as a checkpoint stream: a record with their number, then one record per genome
+inline std::string ne_pack(const std::vector<ne_genome*>& genomes) {
+    std::ostringstream os;
+    
+    {
+        ne_writer w(os);
+        w.begin(1);
+        w.word(genomes.size());
+        w.end();
+        
+        for(const ne_genome* g : genomes)
+            g->write(w);
+        
+        w.close();
+    }
+    
+    return os.str();
+}
+
+inline bool ne_unpack(const std::string& message, std::vector<ne_genome>& genomes) {
+    std::istringstream is(message);
+    ne_reader r(is);
+    
+    if(r.begin() != 1) return false;
+    size_t count = r.word();
+    if(!r.end() || count > message.size() / sizeof(uint64_t)) return false;
+    
+    genomes.clear();
+    genomes.reserve(count);
+    
+    while(r.good && genomes.size() != count)
+        genomes.emplace_back(r);
+    
+    return r.good;
+}
+
+// one island of a ring of processes on this machine. each binds a unix datagram socket at prefix.index,
+// sends to the next island without waiting and takes whatever the previous one has sent so far, so a slow
+// or missing neighbour never holds up a generation.
+// a datagram can't be larger than the socket's send buffer, which the kernel caps at wmem_max whatever is
+// asked for, so a message goes out in chunks that fit the buffer it got, each led by the message's sequence
+// number, its own index and the number of chunks. a unix socket keeps one sender's datagrams in order
+// and never drops them, so a message only arrives in part when the sender gave up on it halfway
+struct ne_island {
+    static const size_t capacity = 1 << 22;
+    static const size_t header = 3 * sizeof(uint64_t);
+    
+    std::string prefix;
+    size_t index;
+    size_t count;
+    
+    int fd;
+    
+    // the most bytes of a message in one datagram
+    size_t chunk;
+    
+    std::vector<char> buffer;
+    
+    // of the next message sent
+    uint64_t sequence;
+    
+    // the message being put together, and the chunk it needs next
+    std::string partial;
+    uint64_t partial_sequence;
+    uint64_t partial_next;
+    
+    size_t sent;
+    size_t received;
+    size_t lost;
+    
+    // messages that could not go out because a chunk was still too large for the socket
+    size_t oversized;
+    
+    ne_island(const std::string& prefix, size_t index, size_t count) : prefix(prefix), index(index), count(count), fd(-1), chunk(0), sequence(0), partial_sequence(0), partial_next(~(uint64_t)0), sent(0), received(0), lost(0), oversized(0) {}
+    
+    ne_island(const ne_island& island) = delete;
+    
+    ne_island& operator = (const ne_island& island) = delete;
+    
+    ~ne_island() {
+        if(fd == -1) return;
+        close(fd);
+        unlink(path(index).c_str());
+    }
+    
+    std::string path(size_t i) const {
+        return prefix + "." + std::to_string(i);
+    }
+    
+    static sockaddr_un address(const std::string& path) {
+        sockaddr_un a;
+        memset(&a, 0, sizeof(a));
+        a.sun_family = AF_UNIX;
+        strncpy(a.sun_path, path.c_str(), sizeof(a.sun_path) - 1);
+        return a;
+    }
+    
+    bool open() {
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if(fd == -1) return false;
+        
+        int size = capacity;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        
+        // half of what the kernel reports, which is twice what it gives to data, leaving room for its overhead.
+        // linux's default buffer if it won't say
+        socklen_t length = sizeof(size);
+        if(getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, &length) != 0) size = 212992;
+        chunk = std::max((size_t)size / 2, 2 * header) - header;
+        
+        std::string own = path(index);
+        unlink(own.c_str());
+        
+        sockaddr_un a = address(own);
+        if(bind(fd, (const sockaddr*)&a, sizeof(a)) != 0) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        
+        buffer.resize(header + chunk);
+        return true;
+    }
+    
+    // dropped when the next island isn't up yet or its queue is full, counted in oversized rather than lost
+    // if even one chunk is too large for the socket
+    void send(const std::string& message) {
+        sockaddr_un a = address(path((index + 1) % count));
+        
+        uint64_t chunks = std::max((message.size() + chunk - 1) / chunk, (size_t)1);
+        
+        for(uint64_t k = 0; k != chunks; ++k) {
+            size_t offset = k * chunk;
+            size_t size = message.size() - offset;
+            if(size > chunk) size = chunk;
+            
+            uint64_t head[3] = {sequence, k, chunks};
+            memcpy(buffer.data(), head, header);
+            memcpy(buffer.data() + header, message.data() + offset, size);
+            
+            if(sendto(fd, buffer.data(), header + size, MSG_DONTWAIT, (const sockaddr*)&a, sizeof(a)) != (ssize_t)(header + size)) {
+                if(errno == EMSGSIZE) {
+                    ++oversized;
+                }else{
+                    ++lost;
+                }
+                
+                ++sequence;
+                return;
+            }
+        }
+        
+        ++sequence;
+        ++sent;
+    }
+    
+    // the next whole message, skipping what is left of any message whose sender gave up on it
+    bool receive(std::string& message) {
+        for(;;) {
+            ssize_t size = recv(fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+            if(size <= 0) return false;
+            if((size_t)size < header) continue;
+            
+            uint64_t head[3];
+            memcpy(head, buffer.data(), header);
+            
+            if(head[1] == 0) {
+                partial.clear();
+                partial_sequence = head[0];
+                partial_next = 0;
+            }
+            
+            if(head[0] != partial_sequence || head[1] != partial_next) {
+                partial_next = ~(uint64_t)0;
+                continue;
+            }
+            
+            partial.append(buffer.data() + header, size - header);
+            ++partial_next;
+            
+            if(partial_next == head[2]) {
+                message.swap(partial);
+                partial.clear();
+                partial_next = ~(uint64_t)0;
+                ++received;
+                return true;
+            }
+        }
+    }
+};
+
+#endif /* islands_h */
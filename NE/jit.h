@@ -0,0 +1,309 @@
+//
+//  jit.h
+//  NE
+//
+//  Created by Arthur Sun on 10/1/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef jit_h
+#define jit_h
+
+#include "network.h"
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// lowers a genome to c++ with its layout and weights as constants, builds that with the local compiler into
+// a shared library and loads it. the code does what the exact kernels do, operation for operation, so it
+// scores a genome exactly as its ne_network would. a build takes the compiler seconds for a large genome,
+// so builds run on a thread of their own: compile() hands the genome over and says no until its library is
+// ready, and networks go on with their arrays meanwhile. only the latest genome handed over is built. when
+// there is no working compiler every build fails and the arrays are all there is
+
+struct ne_jit {
+    // the compiler to build with, NE_CXX if set
+    std::string compiler;
+    
+    ne_frozen code;
+    void* library;
+    
+    // of the genome the library was built from
+    uint64_t signature;
+    
+    // the genome waiting for the thread, the signature of the last one handed over, and the last library
+    // the thread built until compile() takes it
+    ne_genome* pending;
+    uint64_t requested;
+    
+    ne_frozen ready_code;
+    void* ready;
+    uint64_t ready_signature;
+    
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    
+    size_t built;
+    size_t failed;
+    bool building;
+    bool quit;
+    
+    ne_jit() : library(nullptr), signature(0), pending(nullptr), requested(0), ready(nullptr), ready_signature(0), built(0), failed(0), building(false), quit(false) {
+        const char* cxx = getenv("NE_CXX");
+        compiler = cxx != nullptr ? cxx : "c++";
+        
+        code.activate = nullptr;
+        code.step = nullptr;
+        
+        thread = std::thread(&ne_jit::loop, this);
+    }
+    
+    ne_jit(const ne_jit& jit) = delete;
+    
+    ne_jit& operator = (const ne_jit& jit) = delete;
+    
+    ~ne_jit() {
+        stop();
+        close();
+        
+        if(ready != nullptr) dlclose(ready);
+        delete pending;
+    }
+    
+    // waits out the build under way, if any, and drops the one waiting
+    void stop() {
+        if(!thread.joinable()) return;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        
+        wake.notify_one();
+        thread.join();
+    }
+    
+    void close() {
+        if(library != nullptr) dlclose(library);
+        library = nullptr;
+        
+        code.activate = nullptr;
+        code.step = nullptr;
+    }
+    
+    // everything the code depends on: the shape and every link, in order
+    static uint64_t sign(const ne_genome& genome) {
+        uint64_t h = ne_mix(genome.input_size);
+        h = ne_checksum(h, genome.output_size);
+        h = ne_checksum(h, genome.node_size);
+        
+        for(const ne_link& link : genome.links) {
+            uint64_t bits;
+            memcpy(&bits, &link.weight, sizeof(bits));
+            h = ne_checksum(ne_checksum(h, link.key()), bits);
+        }
+        
+        return ne_mix(h);
+    }
+    
+    static std::string constant(double w) {
+        char s[32];
+        snprintf(s, sizeof(s), "%a", w);
+        return s;
+    }
+    
+    // a translation unit defining ne_frozen_activate and ne_frozen_step for genome, on its own
+    // so it can also be built into whatever deploys the genome
+    static std::string source(const ne_genome& genome) {
+        ne_network network;
+        network.accuracy = ne_exact;
+        network.compile(genome);
+        
+        size_t size = network.size();
+        const size_t* o = network.offsets.data();
+        const size_t* s = network.sources.data();
+        const double* w = network.weights.data();
+        
+        std::ostringstream os;
+        os << "// " << genome.input_size << " inputs, " << genome.output_size << " outputs, " << size << " nodes, " << network.sources.size() << " links\n";
+        os << "#include <cmath>\n#include <cstddef>\n\n";
+        
+        os << "extern \"C\" void ne_frozen_activate(double* v) {\n";
+        os << "    double s;\n";
+        
+        for(size_t i = network.input_size; i != size; ++i) {
+            os << "    s = 0.0;\n";
+            
+            for(size_t k = o[i]; k != o[i + 1]; ++k)
+                os << "    s += " << constant(w[k]) << " * v[" << s[k] << "];\n";
+            
+            os << "    v[" << i << "] = std::tanh(s);\n";
+        }
+        
+        os << "}\n\n";
+        
+        os << "extern \"C\" void ne_frozen_step(double* v, size_t lanes, size_t n) {\n";
+        
+        for(size_t i = network.input_size; i != size; ++i) {
+            os << "    for(size_t q = 0; q != n; ++q) {\n";
+            os << "        double s = 0.0;\n";
+            
+            for(size_t k = o[i]; k != o[i + 1]; ++k)
+                os << "        s += " << constant(w[k]) << " * v[" << s[k] << " * lanes + q];\n";
+            
+            os << "        v[" << i << " * lanes + q] = std::tanh(s);\n";
+            os << "    }\n";
+        }
+        
+        os << "}\n";
+        
+        return os.str();
+    }
+    
+    // whether code runs genome, which is handed to the thread to build unless it already has been
+    bool compile(const ne_genome& genome) {
+        uint64_t h = sign(genome);
+        bool handed = false;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            
+            if(ready != nullptr) {
+                close();
+                
+                library = ready;
+                code = ready_code;
+                signature = ready_signature;
+                ready = nullptr;
+            }
+            
+            if(h != requested && !(library != nullptr && h == signature)) {
+                delete pending;
+                pending = new ne_genome(genome);
+                requested = h;
+                handed = true;
+            }
+        }
+        
+        if(handed) wake.notify_one();
+        
+        return library != nullptr && h == signature;
+    }
+    
+    // compile(), waiting for the thread to build genome if it has to
+    bool compile_now(const ne_genome& genome) {
+        if(compile(genome)) return true;
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            
+            idle.wait(lock, [this] {
+                return pending == nullptr && !building;
+            });
+        }
+        
+        return compile(genome);
+    }
+    
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        while(true) {
+            wake.wait(lock, [this] {
+                return quit || pending != nullptr;
+            });
+            
+            if(quit) return;
+            
+            ne_genome* genome = pending;
+            pending = nullptr;
+            building = true;
+            
+            lock.unlock();
+            
+            uint64_t h = sign(*genome);
+            ne_frozen c;
+            void* l = build(*genome, c);
+            
+            delete genome;
+            lock.lock();
+            
+            building = false;
+            
+            if(l == nullptr) {
+                ++failed;
+            }else{
+                // one compile() never took, already behind this one
+                if(ready != nullptr) dlclose(ready);
+                
+                ready = l;
+                ready_code = c;
+                ready_signature = h;
+                ++built;
+            }
+            
+            idle.notify_all();
+        }
+    }
+    
+    // the library built from genome with its functions in c, or nullptr
+    void* build(const ne_genome& genome, ne_frozen& c) const {
+        char dir[] = "/tmp/NE_jit.XXXXXX";
+        if(mkdtemp(dir) == nullptr) return nullptr;
+        
+        std::string path = dir;
+        std::string src = path + "/network.cpp";
+        std::string lib = path + "/network.so";
+        
+        {
+            std::ofstream os(src);
+            os << source(genome);
+        }
+        
+        // no contraction into fused multiply-adds, which the kernels aren't built with either. -O1 runs this
+        // straight line code as fast as -O2 and builds it in well under half the time
+        std::string command = compiler + " -O1 -ffp-contract=off -shared -fPIC -o " + lib + " " + src + " 1>&2";
+        
+        void* handle = nullptr;
+        int status = system(command.c_str());
+        
+        if(status == 0) {
+            handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if(handle == nullptr) std::cerr << "jit: can't load " << lib << ": " << dlerror() << '\n';
+        }else if(status == -1) {
+            std::cerr << "jit: can't run " << compiler << '\n';
+        }else if(WIFEXITED(status)) {
+            std::cerr << "jit: " << compiler << " exited with status " << WEXITSTATUS(status) << '\n';
+        }else{
+            std::cerr << "jit: " << compiler << " was killed by signal " << WTERMSIG(status) << '\n';
+        }
+        
+        unlink(src.c_str());
+        unlink(lib.c_str());
+        rmdir(dir);
+        
+        if(handle == nullptr) return nullptr;
+        
+        c.activate = (void (*)(double*))dlsym(handle, "ne_frozen_activate");
+        c.step = (void (*)(double*, size_t, size_t))dlsym(handle, "ne_frozen_step");
+        
+        if(c.activate == nullptr || c.step == nullptr) {
+            dlclose(handle);
+            return nullptr;
+        }
+        
+        return handle;
+    }
+};
+
+#endif /* jit_h */
@@ -0,0 +1,277 @@
+//
+//  kernels.h
+//  NE
+//
+//  Created by Arthur Sun on 9/18/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef kernels_h
+#define kernels_h
+
+#include "ne.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define ne_x86
+#endif
+
+// weighted sums and activations used by ne_network, picked once per accuracy mode from what the cpu supports.
+// ne_exact keeps the scalar summation order and libm tanh, so its results match bit for bit on every machine;
+// ne_fast gathers sums in vector lanes and uses a rational tanh (absolute error below 3e-8)
+
+struct ne_kernels {
+    // t[q] += w * y[q]
+    void (*axpy)(double* t, double w, const double* y, size_t n);
+    
+    // sum of w[k] * v[s[k]]
+    double (*dot)(const double* w, const size_t* s, const double* v, size_t n);
+    
+    // y[q] = tanh(t[q])
+    void (*tanh)(double* y, const double* t, size_t n);
+};
+
+static const double ne_tanh_clamp = 9.0;
+
+static const double ne_tanh_a[7] = {4.89352455891786e-03, 6.37261928875436e-04, 1.48572235717979e-05, 5.12229709037114e-08, -8.60467152213735e-11, 2.00018790482477e-13, -2.76076847742355e-16};
+
+static const double ne_tanh_b[4] = {4.89352518554385e-03, 2.26843463243900e-03, 1.18534705686654e-04, 1.19825839466702e-06};
+
+inline double ne_fast_tanh(double x) {
+    x = fmin(fmax(x, -ne_tanh_clamp), ne_tanh_clamp);
+    double x2 = x * x;
+    
+    double p = ne_tanh_a[6];
+    for(int k = 5; k >= 0; --k)
+        p = p * x2 + ne_tanh_a[k];
+    
+    double q = ne_tanh_b[3];
+    for(int k = 2; k >= 0; --k)
+        q = q * x2 + ne_tanh_b[k];
+    
+    return x * p / q;
+}
+
+inline void ne_axpy_scalar(double* t, double w, const double* y, size_t n) {
+    for(size_t q = 0; q != n; ++q)
+        t[q] += w * y[q];
+}
+
+inline double ne_dot_scalar(const double* w, const size_t* s, const double* v, size_t n) {
+    double sum = 0.0;
+    for(size_t k = 0; k != n; ++k)
+        sum += w[k] * v[s[k]];
+    return sum;
+}
+
+inline void ne_tanh_exact(double* y, const double* t, size_t n) {
+    for(size_t q = 0; q != n; ++q)
+        y[q] = tanh(t[q]);
+}
+
+inline void ne_tanh_scalar(double* y, const double* t, size_t n) {
+    for(size_t q = 0; q != n; ++q)
+        y[q] = ne_fast_tanh(t[q]);
+}
+
+#ifdef ne_x86
+
+inline void ne_axpy_sse(double* t, double w, const double* y, size_t n) {
+    __m128d x = _mm_set1_pd(w);
+    size_t q = 0;
+    for(; q + 2 <= n; q += 2)
+        _mm_storeu_pd(t + q, _mm_add_pd(_mm_loadu_pd(t + q), _mm_mul_pd(x, _mm_loadu_pd(y + q))));
+    ne_axpy_scalar(t + q, w, y + q, n - q);
+}
+
+inline void ne_tanh_sse(double* y, const double* t, size_t n) {
+    __m128d lo = _mm_set1_pd(-ne_tanh_clamp);
+    __m128d hi = _mm_set1_pd(ne_tanh_clamp);
+    size_t q = 0;
+    for(; q + 2 <= n; q += 2) {
+        __m128d x = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(t + q), lo), hi);
+        __m128d x2 = _mm_mul_pd(x, x);
+        
+        __m128d p = _mm_set1_pd(ne_tanh_a[6]);
+        for(int k = 5; k >= 0; --k)
+            p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(ne_tanh_a[k]));
+        
+        __m128d r = _mm_set1_pd(ne_tanh_b[3]);
+        for(int k = 2; k >= 0; --k)
+            r = _mm_add_pd(_mm_mul_pd(r, x2), _mm_set1_pd(ne_tanh_b[k]));
+        
+        _mm_storeu_pd(y + q, _mm_div_pd(_mm_mul_pd(x, p), r));
+    }
+    ne_tanh_scalar(y + q, t + q, n - q);
+}
+
+__attribute__((target("avx2")))
+inline void ne_axpy_avx2(double* t, double w, const double* y, size_t n) {
+    __m256d x = _mm256_set1_pd(w);
+    size_t q = 0;
+    for(; q + 4 <= n; q += 4)
+        _mm256_storeu_pd(t + q, _mm256_add_pd(_mm256_loadu_pd(t + q), _mm256_mul_pd(x, _mm256_loadu_pd(y + q))));
+    for(; q != n; ++q)
+        t[q] += w * y[q];
+}
+
+__attribute__((target("avx2,fma")))
+inline void ne_axpy_fma(double* t, double w, const double* y, size_t n) {
+    __m256d x = _mm256_set1_pd(w);
+    size_t q = 0;
+    for(; q + 4 <= n; q += 4)
+        _mm256_storeu_pd(t + q, _mm256_fmadd_pd(x, _mm256_loadu_pd(y + q), _mm256_loadu_pd(t + q)));
+    for(; q != n; ++q)
+        t[q] += w * y[q];
+}
+
+__attribute__((target("avx2,fma")))
+inline double ne_dot_avx2(const double* w, const size_t* s, const double* v, size_t n) {
+    __m256d sum = _mm256_setzero_pd();
+    size_t k = 0;
+    for(; k + 4 <= n; k += 4) {
+        __m256i i = _mm256_loadu_si256((const __m256i*)(s + k));
+        sum = _mm256_fmadd_pd(_mm256_loadu_pd(w + k), _mm256_i64gather_pd(v, i, 8), sum);
+    }
+    
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    double r = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+    
+    for(; k != n; ++k)
+        r += w[k] * v[s[k]];
+    return r;
+}
+
+__attribute__((target("avx2,fma")))
+inline void ne_tanh_avx2(double* y, const double* t, size_t n) {
+    __m256d lo = _mm256_set1_pd(-ne_tanh_clamp);
+    __m256d hi = _mm256_set1_pd(ne_tanh_clamp);
+    size_t q = 0;
+    for(; q + 4 <= n; q += 4) {
+        __m256d x = _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(t + q), lo), hi);
+        __m256d x2 = _mm256_mul_pd(x, x);
+        
+        __m256d p = _mm256_set1_pd(ne_tanh_a[6]);
+        for(int k = 5; k >= 0; --k)
+            p = _mm256_fmadd_pd(p, x2, _mm256_set1_pd(ne_tanh_a[k]));
+        
+        __m256d r = _mm256_set1_pd(ne_tanh_b[3]);
+        for(int k = 2; k >= 0; --k)
+            r = _mm256_fmadd_pd(r, x2, _mm256_set1_pd(ne_tanh_b[k]));
+        
+        _mm256_storeu_pd(y + q, _mm256_div_pd(_mm256_mul_pd(x, p), r));
+    }
+    ne_tanh_scalar(y + q, t + q, n - q);
+}
+
+__attribute__((target("avx512f")))
+inline void ne_axpy_avx512(double* t, double w, const double* y, size_t n) {
+    __m512d x = _mm512_set1_pd(w);
+    size_t q = 0;
+    for(; q + 8 <= n; q += 8)
+        _mm512_storeu_pd(t + q, _mm512_fmadd_pd(x, _mm512_loadu_pd(y + q), _mm512_loadu_pd(t + q)));
+    if(q != n) {
+        __mmask8 m = (__mmask8)((1u << (n - q)) - 1);
+        _mm512_mask_storeu_pd(t + q, m, _mm512_fmadd_pd(x, _mm512_maskz_loadu_pd(m, y + q), _mm512_maskz_loadu_pd(m, t + q)));
+    }
+}
+
+__attribute__((target("avx512f")))
+inline double ne_dot_avx512(const double* w, const size_t* s, const double* v, size_t n) {
+    __m512d sum = _mm512_setzero_pd();
+    size_t k = 0;
+    for(; k + 8 <= n; k += 8) {
+        __m512i i = _mm512_loadu_si512((const void*)(s + k));
+        sum = _mm512_fmadd_pd(_mm512_loadu_pd(w + k), _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xff, i, v, 8), sum);
+    }
+    
+    // by hand and through the masked forms, since gcc 12 warns that the unmasked ones read an uninitialized
+    // register. the lanes are added in the same order _mm512_reduce_add_pd adds them
+    __m256d h = _mm256_add_pd(_mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xf, sum, 0), _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xf, sum, 1));
+    __m128d d = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+    double r = _mm_cvtsd_f64(_mm_add_sd(d, _mm_unpackhi_pd(d, d)));
+    
+    for(; k != n; ++k)
+        r += w[k] * v[s[k]];
+    return r;
+}
+
+__attribute__((target("avx512f")))
+inline void ne_tanh_avx512(double* y, const double* t, size_t n) {
+    __m512d lo = _mm512_set1_pd(-ne_tanh_clamp);
+    __m512d hi = _mm512_set1_pd(ne_tanh_clamp);
+    size_t q = 0;
+    for(; q < n; q += 8) {
+        __mmask8 m = n - q >= 8 ? (__mmask8)0xff : (__mmask8)((1u << (n - q)) - 1);
+        __m512d x = _mm512_maskz_loadu_pd(m, t + q);
+        x = _mm512_mask_max_pd(x, 0xff, x, lo);
+        x = _mm512_mask_min_pd(x, 0xff, x, hi);
+        __m512d x2 = _mm512_mul_pd(x, x);
+        
+        __m512d p = _mm512_set1_pd(ne_tanh_a[6]);
+        for(int k = 5; k >= 0; --k)
+            p = _mm512_fmadd_pd(p, x2, _mm512_set1_pd(ne_tanh_a[k]));
+        
+        __m512d r = _mm512_set1_pd(ne_tanh_b[3]);
+        for(int k = 2; k >= 0; --k)
+            r = _mm512_fmadd_pd(r, x2, _mm512_set1_pd(ne_tanh_b[k]));
+        
+        _mm512_mask_storeu_pd(y + q, m, _mm512_div_pd(_mm512_mul_pd(x, p), r));
+    }
+}
+
+#endif
+
+inline ne_kernels ne_select_kernels(ne_accuracy accuracy) {
+    ne_kernels k;
+
+#ifdef ne_x86
+    __builtin_cpu_init();
+#endif
+    
+    if(accuracy == ne_exact) {
+        k.axpy = ne_axpy_scalar;
+        k.dot = ne_dot_scalar;
+        k.tanh = ne_tanh_exact;
+
+#ifdef ne_x86
+        // plain multiply then add keeps every lane's rounding identical to the scalar loop
+        k.axpy = __builtin_cpu_supports("avx2") ? ne_axpy_avx2 : ne_axpy_sse;
+#endif
+        return k;
+    }
+    
+    k.axpy = ne_axpy_scalar;
+    k.dot = ne_dot_scalar;
+    k.tanh = ne_tanh_scalar;
+
+#ifdef ne_x86
+    if(__builtin_cpu_supports("avx512f")) {
+        k.axpy = ne_axpy_avx512;
+        k.dot = ne_dot_avx512;
+        k.tanh = ne_tanh_avx512;
+    }else if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        k.axpy = ne_axpy_fma;
+        k.dot = ne_dot_avx2;
+        k.tanh = ne_tanh_avx2;
+    }else{
+        k.axpy = ne_axpy_sse;
+        k.tanh = ne_tanh_sse;
+    }
+#endif
+    
+    return k;
+}
+
+inline ne_accuracy& ne_default_accuracy() {
+    static ne_accuracy accuracy = ne_exact;
+    return accuracy;
+}
+
+inline const ne_kernels& ne_get_kernels(ne_accuracy accuracy) {
+    static const ne_kernels exact = ne_select_kernels(ne_exact);
+    static const ne_kernels fast = ne_select_kernels(ne_fast);
+    return accuracy == ne_fast ? fast : exact;
+}
+
+#endif /* kernels_h */
@@ -7,556 +7,246 @@
 //
 
 #include <iostream>
-#include <iomanip>
 #include <thread>
+#include <cassert>
+#include <sys/wait.h>
 #include "population.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "cache.h"
+#include "checkpointer.h"
+#include "islands.h"
+#include "farm.h"
+#include "jit.h"
 
 ne_population* population;
 
-#define time_limit 1000
-
-#define time_step 0.01f
-
 int gens;
 ne_settings settings;
 
 int pe = 16;
 int tr = 256;
 
-struct Pendulum
-{
-    static const size_t input_size = 4;
-    static const size_t output_size = 1;
-    
-    float x;
-    float vx;
-    float a;
-    float va;
-    
-    float g;
-    float m_c;
-    float m_p;
-    float m;
-    float l;
-    float f;
-    float b;
-    
-    float xt = 10.0;
-    
-    float fitness;
-    
-    Pendulum() {
-        g = 9.8;
-        m_c = 0.5;
-        m_p = 0.5;
-        m = m_c + m_p;
-        l = 0.6;
-        f = 20.0;
-        b = 0.1;
-    }
-    
-    void reset() {
-        x = ne_random(-2.0, 2.0);
-        vx = ne_random(-4.0, 4.0);
-        a = 0.1;
-        va = ne_random(-M_PI, M_PI);
-    }
-    
-    void run(ne_genome* gen, bool p) {
-        fitness = 0.0;
-        
-        reset();
-        gen->flush();
-        
-        ne_node** inputs = gen->inputs();
-        ne_node** outputs = gen->outputs();
-        
-        for(int i = 0; i < time_limit; ++i) {
-            float c = cos(a);
-            float s = sin(a);
-            
-            float action = 0.0;
-            
-            inputs[0]->value = 1.0;
-            inputs[1]->value = x / xt;
-            inputs[2]->value = c;
-            inputs[3]->value = s;
-            
-            gen->activate();
-            
-            action = outputs[0]->value * 2.0 - 1.0;
-            
-            action *= f;
-            
-            float va2 = va * va;
-            float c2 = c * c;
+// the task named in the settings, and an instance of it for every worker of the scheduler
+const ne_task_entry* task;
 
-            float vva = (g * m * s + c * (action - m_p * l * va2 * s - b * vx))/(l * (m - m_p * c2));
-            float vvx = (action + m_p * l * (vva * c - va2 * s) - b * vx) / m;
-            
-            vx = vx + vvx * time_step;
-            va = va + vva * time_step;
-            
-            x = x + vx * time_step;
-            a = a + va * time_step;
-            
-            if(x < -xt || x > xt)
-                break;
-            
-            float f1 = fmax(cos(a), 0.0);
-            float f2 = (xt - fabs(x)) / xt;
-            
-            fitness += f1 + (f1 * f2);
-            
-            if(p) {
-                std::cout << x << ", " << a << ", " << '\n';
-            }
-        }
-        
-        fitness /= 2000.0;
-    }
-    
-};
+ne_scheduler* scheduler;
 
+std::vector<ne_task*> objs;
 
-struct XOR
-{
-    static const size_t input_size = 3;
-    static const size_t output_size = 1;
-    
-    float fitness;
-    
-    void run(ne_genome* gen, bool p) {
-        fitness = 0.0;
-        
-        ne_node** inputs = gen->inputs();
-        ne_node** outputs = gen->outputs();
-        
-        for(int a = 0; a < 2; ++a) {
-            for(int b = 0; b < 2; ++b) {
-                int c = a ^ b;
-                
-                inputs[0]->value = 1.0;
-                inputs[1]->value = a;
-                inputs[2]->value = b;
-                
-                gen->flush();
-                gen->activate();
-                
-                float d = outputs[0]->value - c;
-                fitness += 1.0 - d * d;
-                
-                if(p) {
-                    std::cout << outputs[0]->value << '\n';
-                }
-            }
-        }
-        
-        fitness *= 0.25;
-    }
-};
+ne_checkpointer* checkpointer = nullptr;
 
-struct Game2048
-{
-    static const size_t input_size = 17;
-    static const size_t output_size = 4;
-    
-    float fitness;
-    
-    size_t grid[16];
-    
-    inline size_t& get(int x, int y) {
-        return grid[x + y * 4];
-    }
+ne_island* island = nullptr;
+
+std::vector<pid_t> children;
+
+ne_farm* farm = nullptr;
+
+ne_jit* jit = nullptr;
+
+// NE_WORKER if set, otherwise NE_worker next to this executable
+std::string worker;
+
+// argv[0] is only a path to the executable when it was run by one, not when it was found on PATH
+std::string executable(const char* argv0) {
+    char path[4096];
+    ssize_t size = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return size > 0 ? std::string(path, size) : std::string(argv0);
+}
+
+// starts from the settings file, or from a checkpoint when given one
+bool initialize(const char* resume) {
+    ne_register_tasks();
     
-    void reset() {
-        for(int i = 0; i < 16; ++i) {
-            grid[i] = 0;
-        }
+    if(resume == nullptr) {
+        std::ifstream is("settings");
+        settings = ne_settings(is);
+        is.close();
         
-        add2();
-    }
-    
-    void add2() {
-        std::vector<int> idx;
-        for(int i = 0; i < 16; ++i) {
-            if(grid[i] == 0) idx.push_back(i);
-        }
+        task = ne_find_task(settings.task);
         
-        grid[idx[ne_random(0lu, idx.size() - 1)]] = ne_random(0.0, 1.0) < 0.9 ? 2 : 4;
-    }
-    
-    size_t move_left(bool& moved) {
-        size_t score = 0;
-        for(int y = 0; y < 4; ++y) {
-            for(int x = 0; x < 4; ++x) {
-                size_t v1 = get(x, y);
-                if(v1 == 0) continue;
-                
-                for(int i = x + 1; i < 4; ++i) {
-                    size_t v2 = get(i, y);
-                    if(v1 == v2) {
-                        score += v1 + v2;
-                        moved = true;
-                        
-                        get(x, y) += get(i, y);
-                        get(i, y) = 0;
-                        
-                        break;
-                    }else if(v1 != v2 && v2 != 0) {
-                        break;
-                    }
-                }
-                
-                int l = x;
-                while(l != 0 && get(l - 1, y) == 0) {
-                    get(l - 1, y) = get(l, y);
-                    get(l, y) = 0;
-                    --l;
-                    
-                    moved = true;
-                }
-            }
+        if(task == nullptr) {
+            std::cerr << "unknown task: " << settings.task << '\n';
+            return false;
         }
-        return score;
-    }
-    
-    size_t move_right(bool& moved) {
-        size_t score = 0;
-        for(int y = 0; y < 4; ++y) {
-            for(int x = 3; x >= 0; --x) {
-                size_t v1 = get(x, y);
-                if(v1 == 0) continue;
+        
+        // the other islands are forked off here, before any thread starts, and write to island.<number>.out
+        if(settings.islands > 1) {
+            std::cout.flush();
+            
+            for(size_t k = 1; k < settings.islands; ++k) {
+                pid_t pid = fork();
                 
-                for(int i = x - 1; i >= 0; --i) {
-                    size_t v2 = get(i, y);
-                    if(v1 == v2) {
-                        score += v1 + v2;
-                        moved = true;
-                        
-                        get(x, y) += get(i, y);
-                        get(i, y) = 0;
-                        
-                        break;
-                    }else if(v1 != v2 && v2 != 0) {
-                        break;
-                    }
+                if(pid == 0) {
+                    children.clear();
+                    settings.island = k;
+                    freopen(("island." + std::to_string(k) + ".out").c_str(), "w", stdout);
+                    break;
                 }
                 
-                int r = x;
-                while(r != 3 && get(r + 1, y) == 0) {
-                    get(r + 1, y) = get(r, y);
-                    get(r, y) = 0;
-                    ++r;
+                if(pid < 0) {
+                    std::cerr << "can't fork island " << k << ": " << strerror(errno) << '\n';
                     
-                    moved = true;
-                }
-            }
-        }
-        return score;
-    }
-    
-    size_t move_up(bool& moved) {
-        size_t score = 0;
-        for(int x = 0; x < 4; ++x) {
-            for(int y = 0; y < 4; ++y) {
-                size_t v1 = get(x, y);
-                if(v1 == 0) continue;
-                
-                for(int i = y + 1; i < 4; ++i) {
-                    size_t v2 = get(x, i);
-                    if(v1 == v2) {
-                        score += v1 + v2;
-                        moved = true;
-                        
-                        get(x, y) += get(x, i);
-                        get(x, i) = 0;
-
-                        break;
-                    }else if(v1 != v2 && v2 != 0) {
-                        break;
+                    for(pid_t child : children) {
+                        kill(child, SIGTERM);
+                        waitpid(child, nullptr, 0);
                     }
-                }
-                
-                int u = y;
-                while(u != 0 && get(x, u - 1) == 0) {
-                    get(x, u - 1) = get(x, u);
-                    get(x, u) = 0;
-                    --u;
                     
-                    moved = true;
+                    return false;
                 }
-            }
-        }
-        return score;
-    }
-    
-    size_t move_down(bool& moved) {
-        size_t score = 0;
-        for(int x = 0; x < 4; ++x) {
-            for(int y = 3; y >= 0; --y) {
-                size_t v1 = get(x, y);
-                if(v1 == 0) continue;
                 
-                for(int i = y - 1; i >= 0; --i) {
-                    size_t v2 = get(x, i);
-                    if(v1 == v2) {
-                        score += v1 + v2;
-                        moved = true;
-                        
-                        get(x, y) += get(x, i);
-                        get(x, i) = 0;
-                        
-                        break;
-                    }else if(v1 != v2 && v2 != 0) {
-                        break;
-                    }
-                }
-                
-                int d = y;
-                while(d != 3 && get(x, d + 1) == 0) {
-                    get(x, d + 1) = get(x, d);
-                    get(x, d) = 0;
-                    ++d;
-                    
-                    moved = true;
-                }
+                children.push_back(pid);
             }
-        }
-        return score;
-    }
-    
-    int get_move() {
-        for(int i = 0; i < 16; ++i) {
-            if(grid[i] == 0) return -1;
+            
+            settings.seed = ne_mix(settings.seed + settings.island);
         }
         
-        for(int y = 0; y < 4; ++y) {
-            for(int x = 0; x < 4; ++x) {
-                if(x != 3 && get(x + 1, y) == get(x, y)) {
-                    return 0;
-                }
-                if(y != 3 && get(x, y + 1) == get(x, y)) {
-                    return 0;
-                }
-            }
+        ne_reseed(settings.seed);
+        population = new ne_population(settings, task->input_size, task->output_size);
+    }else{
+        ne_reader r(resume);
+        population = new ne_population(r);
+        settings = population->settings;
+        
+        if(!r.good) {
+            std::cerr << "bad checkpoint: " << resume << '\n';
+            return false;
         }
         
-        return 1;
+        task = ne_find_task(settings.task);
+        
+        if(task == nullptr) {
+            std::cerr << "unknown task: " << settings.task << '\n';
+            return false;
+        }
     }
     
-    void print() {
-        for(int y = 0; y < 4; ++y) {
-            for(int x = 0; x < 4; ++x) {
-                std::cout << std::setw(5) << get(x, y) << " ";
-            }
-            
-            std::cout << '\n';
+    ne_default_accuracy() = settings.accuracy;
+    scheduler = new ne_scheduler(std::thread::hardware_concurrency());
+    
+    for(size_t w = 0; w != scheduler->size(); ++w)
+        objs.push_back(task->make());
+    
+    std::string suffix = settings.islands > 1 ? "." + std::to_string(settings.island) : "";
+    
+    if(settings.checkpoint != 0)
+        checkpointer = new ne_checkpointer("checkpoint" + suffix);
+    
+    // frozen code only matches the exact kernels
+    if(settings.jit && settings.accuracy == ne_exact)
+        jit = new ne_jit();
+    
+    if(settings.farm != 0) {
+        farm = new ne_farm(worker, task->name, settings.farm, settings.batch, ne_seed(), settings.accuracy);
+        
+        if(!farm->good) {
+            std::cerr << "can't start workers: " << worker << '\n';
+            return false;
         }
     }
     
-    void run(ne_genome* gen, bool p) {
-        fitness = 0.0;
-        
-        reset();
+    if(settings.islands > 1 && settings.migrate != 0) {
+        island = new ne_island("island", settings.island, settings.islands);
         
-        ne_node** inputs = gen->inputs();
-        ne_node** outputs = gen->outputs();
-        
-        while(true) {
-            int m = get_move();
-            
-            if(p) {
-                print();
-                std::cout << '\n';
-            }
-            
-            if(m == 1) {
-                break;
-            }else{
-                inputs[0]->value = 1.0;
-                for(int i = 0; i < 16; ++i) {
-                    inputs[i + 1]->value = grid[i];
-                }
-                
-                gen->flush();
-                gen->activate();
-                
-                std::vector<int> choices(4);
-                for(int i = 0; i < 4; ++i) choices[i] = i;
-                
-                std::sort(choices.data(), choices.data() + 4, [=] (int a, int b) {
-                    return outputs[a]->value > outputs[b]->value;
-                });
-                
-                bool moved = false;
-                
-                size_t i = 0;
-                while(!moved) {
-                    int c = choices[i];
-                    if(c == 0) {
-                        fitness += move_up(moved);
-                        if(p) std::cout << "up" << '\n';
-                    }else if(c == 1) {
-                        fitness += move_down(moved);
-                        if(p) std::cout << "down" << '\n';
-                    }else if(c == 2) {
-                        fitness += move_left(moved);
-                        if(p) std::cout << "left" << '\n';
-                    }else{
-                        fitness += move_right(moved);
-                        if(p) std::cout << "right" << '\n';
-                    }
-                    ++i;
-                }
-                
-                add2();
-            }
+        if(!island->open()) {
+            std::cerr << "can't open island socket: " << island->path(settings.island) << '\n';
+            return false;
         }
-        
     }
-};
+    
+    return true;
+}
+
+// fitness of the best genome over tr fresh episodes
+void replay(ne_task* obj, ne_genome* g, int n, bool p, float* fitnesses) {
+    std::vector<ne_rng> streams(tr);
+    for(int q = 0; q != tr; ++q)
+        streams[q] = ne_stream(ne_episode_stream, n, q);
+    
+    // with the interpreter if the code can't be built
+    if(jit != nullptr && jit->compile(*g))
+        obj->freeze(&jit->code);
+    
+    obj->evaluate(g, streams.data(), fitnesses, tr, p);
+    obj->freeze(nullptr);
+}
+
+ne_fitness_cache cache;
 
-struct DIR
-{
-    static const size_t input_size = 2;
-    static const size_t output_size = 2;
+// false if the farm lost its workers and some genomes went unevaluated
+bool evaluate(int n) {
+    std::vector<ne_genome*>& genomes = population->genomes;
+    size_t size = genomes.size();
     
-    float fitness;
+    std::vector<size_t> pending;
+    std::vector<uint64_t> keys;
     
-    void run(ne_genome* gen, bool p) {
-        fitness = 0.0;
-        
-        ne_node** inputs = gen->inputs();
-        ne_node** outputs = gen->outputs();
+    // genomes that hash like one already pending this generation, and the index of that one
+    std::vector<std::pair<size_t, size_t>> copies;
+    
+    if(task->deterministic && settings.cache) {
+        std::unordered_map<uint64_t, size_t> first;
+        keys.resize(size);
         
-        float a = 0.0;
-        size_t q = 200;
-        float d;
-        for(size_t n = 0; n < q; ++n) {
-            inputs[0]->value = 1.0;
-            inputs[1]->value = a;//ne_random(-10.0, 10.0);
+        for(size_t i = 0; i != size; ++i) {
+            keys[i] = genomes[i]->hash();
             
-            gen->flush();
-            gen->activate();
+            if(cache.find(keys[i], genomes[i]->fitness)) continue;
             
-            d = outputs[0]->value - cos(a);
-            fitness += (1.0 - d * d) * 0.5;
-            
-            d = outputs[1]->value - sin(a);
-            fitness += (1.0 - d * d) * 0.5;
+            std::unordered_map<uint64_t, size_t>::iterator it = first.find(keys[i]);
+            if(it != first.end()) {
+                copies.push_back(std::make_pair(i, it->second));
+                ++cache.hits;
+                --cache.misses;
+                continue;
+            }
             
-            a += 0.05;
+            first[keys[i]] = i;
+            pending.push_back(i);
         }
-        
-        fitness /= (float) q;
+    }else{
+        pending.resize(size);
+        for(size_t i = 0; i != size; ++i)
+            pending[i] = i;
     }
-};
-
-struct HANDDIGITS
-{
-    static const size_t input_size = 28 * 28 + 1;
-    static const size_t output_size = 10;
-    
-    float fitness;
     
-    unsigned char* images;
-    unsigned char* labels;
-    
-    int k, w, h;
+    if(farm != nullptr) {
+        if(!farm->evaluate(n, genomes, pending)) return false;
+    }else{
+        scheduler->run(pending.size(), [&] (size_t w, size_t k) {
+            size_t i = pending[k];
+            ne_genome* g = genomes[i];
+            ne_rng_scope scope(ne_stream(ne_evaluation_stream, n, i));
+            g->fitness = objs[w]->evaluate(g, false);
+        });
+    }
     
-    HANDDIGITS() {
-        std::ifstream f1;
-        f1.open("train-images-idx3-ubyte", std::fstream::ios_base::binary | std::fstream::ios_base::in);
+    if(task->deterministic && settings.cache) {
+        for(size_t i : pending)
+            cache.insert(keys[i], genomes[i]->fitness);
         
-        std::ifstream f2;
-        f2.open("train-labels-idx1-ubyte", std::fstream::ios_base::binary | std::fstream::ios_base::in);
+        for(const std::pair<size_t, size_t>& c : copies)
+            genomes[c.first]->fitness = genomes[c.second]->fitness;
         
-        assert(f1.is_open() && f2.is_open());
-        
-        f1.read((char*)&k, sizeof(k));
-        f1.read((char*)&k, sizeof(k));
-        f1.read((char*)&w, sizeof(w));
-        f1.read((char*)&h, sizeof(h));
-        
-        k = __builtin_bswap32(k);
-        w = __builtin_bswap32(w);
-        h = __builtin_bswap32(h);
-        
-        images = (unsigned char*)::operator new(sizeof(unsigned char) * k * w * h);
-        f1.read((char*)(images), sizeof(unsigned char) * k * w * h);
-        
-        int nl;
-        
-        f2.read((char*)&nl, sizeof(nl));
-        f2.read((char*)&nl, sizeof(nl));
-        
-        nl = __builtin_bswap32(nl);
-        assert(nl == k);
-        
-        labels = (unsigned char*)::operator new(sizeof(unsigned char) * nl);
-        f2.read((char*)(labels), sizeof(unsigned char) * nl);
-    }
-    
-    ~HANDDIGITS() {
-        ::operator delete(images);
-        ::operator delete(labels);
-    }
-    
-    void load_image(int idx, ne_node** inputs) {
-        int q = w * h;
-        int a = idx * q;
-        for(int i = 0; i < q; ++i) {
-            inputs[i]->value = images[a + i] / 0x1p8;
-        }
+        cache.next();
     }
     
-    void run(ne_genome* gen, bool p) {
-        fitness = 0.0;
-        
-        ne_node** inputs = gen->inputs();
-        ne_node** outputs = gen->outputs();
-        
-        int trials = 100;
-        int correct = 0;
-        
-        for(int n = 0; n < trials; ++n) {
-            int i = (int)ne_random(0, k - 1);
-            int label = labels[i];
-            inputs[0]->value = 1.0;
-            load_image(i, inputs + 1);
-            
-            gen->flush();
-            gen->activate();
-            
-            int h = 0;
-            for(int j = 0; j < 10; ++j) {
-                float expected = label == j ? 1.0 : 0.0;
-                float d = outputs[j]->value - expected;
-                fitness += (1.0 - d * d) * 0.1;
-                
-                if(outputs[j]->value > outputs[h]->value)
-                    h = j;
-                
-                if(p) std::cout << outputs[j]->value << " ";
-            }
-            
-            if(p) std::cout << "label: " << label << '\n';
-            
-            if(h == label) ++correct;
-        }
+    return true;
+}
 
-        fitness = correct;
+// sends the best genomes to the next island and takes in what the previous one sent
+void migrate() {
+    std::vector<ne_genome*> best;
+    population->best(settings.migrants, best);
+    island->send(ne_pack(best));
+    
+    std::string message;
+    std::vector<ne_genome> migrants;
+    
+    while(island->receive(message)) {
+        if(ne_unpack(message, migrants))
+            population->immigrate(migrants);
     }
-};
-
-typedef DIR obj_type;
-
-void initialize() {
-    std::ifstream is("settings");
-    settings = ne_settings(is);
-    is.close();
-    population = new ne_population(settings, obj_type::input_size, obj_type::output_size);
 }
 
 int main(int argc, const char * argv[]) {
@@ -567,45 +257,127 @@ int main(int argc, const char * argv[]) {
         gens = std::stoi(argv[1]);
     }
     
-    initialize();
+    const char* command = getenv("NE_WORKER");
+    
+    if(command != nullptr) {
+        worker = command;
+    }else{
+        std::string path = executable(argv[0]);
+        worker = path.substr(0, path.find_last_of('/') + 1) + "NE_worker";
+    }
+    
+    if(!initialize(argc > 2 ? argv[2] : nullptr))
+        return 1;
+    
+    int first = (int)population->generation;
     
     ne_genome* best = nullptr;
     
     std::vector<float> highs;
     
-    obj_type obj;
+    ne_task* obj = objs[0];
+    
+    int status = 0;
     
-    for(int n = 0; n < gens; ++n) {        
-        for(ne_genome* g : population->genomes) {
-            obj.run(g, false);
-            g->fitness = obj.fitness;
+    for(int n = first; n < gens; ++n) {
+        bool evaluated;
+        
+        {
+            ne_time(ne_evaluate_phase);
+            evaluated = evaluate(n);
+        }
+        
+        if(!evaluated) {
+            std::cerr << "workers stopped starting: " << worker << '\n';
+            status = 1;
+            break;
         }
         
         best = population->analyse();
-
+        
         std::cout << n << " " << best->fitness << '\n';
         
+        ne_memory memory = population->memory();
+        std::cout << "memory: " << memory.genomes << " genomes, " << memory.blocks << " blocks, " << memory.bytes / 1024 << " KB" << '\n';
+        
         if((n%pe) == (pe - 1)) {
+            std::vector<float> fitnesses(tr);
+            replay(obj, best, n, n == gens - 1, fitnesses.data());
+            
             float f = 0.0;
-            for(int q = 0; q != tr; ++q) {
-                obj.run(best, n == gens - 1);
-                f += obj.fitness;
-            }
+            for(int q = 0; q != tr; ++q)
+                f += fitnesses[q];
             std::cout << "fitness: " << f / (float) tr << '\n';
+            
+            if(task->deterministic && settings.cache)
+                std::cout << "cache: " << cache.hits << " hits, " << cache.misses << " misses" << '\n';
+            
+            if(settings.species_distance > 0.0)
+                std::cout << "species: " << population->species.size() << ", " << population->comparisons << " comparisons" << '\n';
         }
         
         highs.push_back(best->fitness);
         
-        population->reproduce();
+        if(island != nullptr && (n % settings.migrate) == (settings.migrate - 1))
+            migrate();
+        
+        population->reproduce(scheduler);
+        
+        if(settings.compact != 0 && population->generation % settings.compact == 0)
+            std::cout << "compact: " << population->pruned.links << " links, " << population->pruned.nodes << " nodes" << '\n';
+        
+        if(checkpointer != nullptr && population->generation % settings.checkpoint == 0) {
+            checkpointer->save(*population);
+        }
+
+#ifdef NE_PROFILE
+        ne_profile_report(std::cout, n);
+#endif
     }
     
     std::cout << "Highs: " << '\n';
     
-    for(size_t i = 0; i < gens; ++i) {
-        std::cout << i << "\t" << highs[i] << '\n';
+    for(size_t i = 0; i < highs.size(); ++i) {
+        std::cout << first + i << "\t" << highs[i] << '\n';
+    }
+    
+    if(jit != nullptr) {
+        jit->stop();
+        std::cout << "jit: " << jit->built << " built, " << jit->failed << " failed" << '\n';
+        
+        // the champion, ready to build into a controller
+        if(best != nullptr) {
+            std::ofstream os("champion.cpp");
+            os << ne_jit::source(*best);
+        }
+        
+        delete jit;
+    }
+    
+    if(farm != nullptr) {
+        std::cout << "farm: " << farm->restarts << " restarts, " << farm->failed << " batches failed" << '\n';
+        delete farm;
     }
     
+    if(island != nullptr) {
+        std::cout << "migrations: " << island->sent << " sent, " << island->received << " received, " << island->lost << " lost, " << island->oversized << " too large" << '\n';
+        delete island;
+    }
+    
+    if(checkpointer != nullptr) {
+        checkpointer->close();
+        std::cout << "checkpoints: " << checkpointer->written << " written, " << checkpointer->dropped << " dropped, " << checkpointer->failed << " failed" << '\n';
+        delete checkpointer;
+    }
+    
+    for(pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+    
+    for(ne_task* obj : objs)
+        delete obj;
+    
+    delete scheduler;
     delete population;
     
-    return 0;
+    return status;
 }
@@ -10,55 +10,178 @@
 #define ne_h
 
 #include <vector>
+#include <memory>
 #include <fstream>
-#include <random>
-#include <unordered_set>
+#include <unordered_map>
 #include <cmath>
 #include <functional>
 #include <cfloat>
+#include <algorithm>
+#include <cstring>
+#include "random.h"
+#include "profile.h"
 
-typedef std::mt19937_64 ne_generator_type;
-
-static ne_generator_type ne_generator = ne_generator_type(std::chrono::high_resolution_clock::now().time_since_epoch().count());
-
-template <class T>
-inline T ne_random(T a, T b) {
-    if(std::is_integral<T>::value) {
-        return std::uniform_int_distribution<T>(a, b)(ne_generator);
-    }
-    
-    return std::uniform_real_distribution<T>(a, b)(ne_generator);
-}
-
-struct ne_link;
-
-struct ne_node {
-    double value;
-    size_t clone;
-    std::vector<ne_link*> links;
+enum ne_accuracy {
+    ne_exact,
+    ne_fast
 };
 
 struct ne_link {
-    ne_node* i;
-    ne_node* j;
+    size_t i;
+    size_t j;
     
     double weight;
     
-    ne_link(ne_node* i, ne_node* j) : i(i), j(j) {}
+    ne_link() {}
+    
+    ne_link(size_t i, size_t j) : i(i), j(j) {}
+    
+    uint64_t key() const {
+        return ((uint64_t)i << 32) | (uint64_t)j;
+    }
 };
 
-struct ne_link_hash {
-    size_t operator () (const ne_link* x) const {
-        return (size_t)x->i ^ (size_t)x->j;
-    }
+// up to capacity links, shared between genomes until one of them writes to it
+struct ne_link_block {
+    static const size_t capacity = 64;
+    
+    size_t size;
+    ne_link links[capacity];
+    
+    ne_link_block() : size(0) {}
 };
 
-struct ne_link_equal {
-    bool operator () (const ne_link* a, const ne_link* b) const {
-        return a->i == b->i && a->j == b->j;
+// the links of a genome in order, copied a block at a time on write, with an open addressing index from
+// each link's key to its number plus one, at most half full. the index is the genome's own rather than the
+// blocks', so a lookup is one probe sequence however many blocks there are. copying the array copies it
+// in one go; it is built on the first find() after clear() and kept up by push_back()
+struct ne_link_array {
+    typedef std::shared_ptr<ne_link_block> block_pointer;
+    
+    static const size_t npos = -1;
+    
+    std::vector<block_pointer> blocks;
+    size_t count;
+    
+    std::vector<uint32_t> index;
+    
+    struct const_iterator {
+        const block_pointer* block;
+        size_t slot;
+        
+        const ne_link& operator * () const {
+            return (*block)->links[slot];
+        }
+        
+        const_iterator& operator ++ () {
+            if(++slot == ne_link_block::capacity) {
+                ++block;
+                slot = 0;
+            }
+            return *this;
+        }
+        
+        bool operator != (const const_iterator& it) const {
+            return block != it.block || slot != it.slot;
+        }
+    };
+    
+    ne_link_array() : count(0) {}
+    
+    size_t size() const {
+        return count;
+    }
+    
+    const ne_link& operator [] (size_t k) const {
+        return blocks[k / ne_link_block::capacity]->links[k % ne_link_block::capacity];
+    }
+    
+    const_iterator begin() const {
+        return {blocks.data(), 0};
+    }
+    
+    const_iterator end() const {
+        return {blocks.data() + count / ne_link_block::capacity, count % ne_link_block::capacity};
+    }
+    
+    ne_link_block& unshare(size_t b) {
+        if(blocks[b].use_count() != 1) {
+            blocks[b] = std::make_shared<ne_link_block>(*blocks[b]);
+            ne_count(ne_allocations, 1);
+        }
+        
+        return *blocks[b];
+    }
+    
+    ne_link& write(size_t k) {
+        return unshare(k / ne_link_block::capacity).links[k % ne_link_block::capacity];
+    }
+    
+    void push_back(const ne_link& link) {
+        if(count % ne_link_block::capacity == 0) {
+            blocks.push_back(std::make_shared<ne_link_block>());
+            ne_count(ne_allocations, 1);
+        }
+        
+        ne_link_block& block = unshare(blocks.size() - 1);
+        block.links[block.size++] = link;
+        ++count;
+        
+        if(index.empty()) return;
+        
+        if(2 * count > index.size()) {
+            rebuild(2 * index.size());
+        }else{
+            insert(link.key(), count - 1);
+        }
+    }
+    
+    void insert(uint64_t key, size_t k) {
+        size_t mask = index.size() - 1;
+        size_t b = ne_mix(key) & mask;
+        
+        while(index[b] != 0)
+            b = (b + 1) & mask;
+        
+        index[b] = (uint32_t)(k + 1);
+    }
+    
+    void rebuild(size_t capacity) {
+        index.assign(capacity, 0);
+        
+        for(size_t k = 0; k != count; ++k)
+            insert((*this)[k].key(), k);
+    }
+    
+    // the number of the link with key, or npos
+    size_t find(uint64_t key) {
+        if(index.empty()) {
+            size_t capacity = 16;
+            while(capacity < 2 * count)
+                capacity *= 2;
+            
+            rebuild(capacity);
+        }
+        
+        size_t mask = index.size() - 1;
+        
+        for(size_t b = ne_mix(key) & mask; index[b] != 0; b = (b + 1) & mask) {
+            size_t k = index[b] - 1;
+            if((*this)[k].key() == key) return k;
+        }
+        
+        return npos;
+    }
+    
+    void reserve(size_t size) {
+        blocks.reserve((size + ne_link_block::capacity - 1) / ne_link_block::capacity);
+    }
+    
+    void clear() {
+        blocks.clear();
+        index.clear();
+        count = 0;
     }
 };
 
-typedef std::unordered_set<ne_link*, ne_link_hash, ne_link_equal> ne_link_set;
-
 #endif /* ne_h */
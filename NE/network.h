@@ -0,0 +1,274 @@
+//
+//  network.h
+//  NE
+//
+//  Created by Arthur Sun on 9/14/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef network_h
+#define network_h
+
+#include "genome.h"
+#include "kernels.h"
+
+// straight-line code for the network of one genome, as made by ne_jit. it does exactly what the exact
+// kernels do: activate() for values laid out as in ne_network, step() for the first n of lanes lanes
+struct ne_frozen {
+    void (*activate)(double* values);
+    void (*step)(double* batch, size_t lanes, size_t n);
+};
+
+// compiled phenotype of a genome: node values in one array, incoming links of node i
+// are [offsets[i], offsets[i + 1]) in the parallel sources/weights arrays. a task that knows its input and
+// output sizes at compile time calls the templated activate and step, which move inputs and outputs and
+// update the output layer in loops of constant length; the hidden nodes in between stay dynamic
+
+struct ne_network {
+    size_t input_size;
+    size_t output_size;
+    
+    ne_accuracy accuracy;
+    const ne_kernels* kernels;
+    
+    std::vector<double> values;
+    
+    std::vector<size_t> offsets;
+    std::vector<size_t> sources;
+    std::vector<double> weights;
+    
+    std::vector<size_t> cursor;
+    
+    size_t lanes;
+    
+    std::vector<double> batch;
+    std::vector<double> sums;
+    
+    // runs instead of the arrays above while set, for whatever genome it was made from
+    const ne_frozen* frozen;
+    
+    ne_network() : input_size(0), output_size(0), accuracy(ne_default_accuracy()), kernels(nullptr), lanes(0), frozen(nullptr) {}
+    
+    ne_network(const ne_genome& genome) : accuracy(ne_default_accuracy()), lanes(0), frozen(nullptr) {
+        compile(genome);
+    }
+    
+    // frozen code only stands in for the exact kernels
+    void freeze(const ne_frozen* code) {
+        frozen = accuracy == ne_exact ? code : nullptr;
+    }
+    
+    void compile(const ne_genome& genome) {
+        input_size = genome.input_size;
+        output_size = genome.output_size;
+        kernels = &ne_get_kernels(accuracy);
+        
+        size_t size = genome.node_size;
+        
+        values.assign(size, 0.0);
+        offsets.assign(size + 1, 0);
+        
+        for(const ne_link& link : genome.links) {
+            if(link.weight == 0.0) continue;
+            ++offsets[genome.position(link.j) + 1];
+        }
+        
+        for(size_t i = 0; i != size; ++i)
+            offsets[i + 1] += offsets[i];
+        
+        sources.resize(offsets[size]);
+        weights.resize(offsets[size]);
+        cursor.assign(offsets.begin(), offsets.end() - 1);
+        
+        for(const ne_link& link : genome.links) {
+            if(link.weight == 0.0) continue;
+            size_t k = cursor[genome.position(link.j)]++;
+            sources[k] = genome.position(link.i);
+            weights[k] = link.weight;
+        }
+    }
+    
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+    
+    double* inputs() {
+        return values.data();
+    }
+    
+    double* outputs() {
+        return values.data() + values.size() - output_size;
+    }
+    
+    void flush() {
+        std::fill(values.begin() + input_size, values.end(), 0.0);
+    }
+    
+    void activate() {
+        if(thaw()) update(input_size, values.size());
+    }
+    
+    template <size_t I, size_t O>
+    void activate() {
+        assert(input_size == I && output_size == O);
+        if(!thaw()) return;
+        
+        size_t size = values.size();
+        update(I, size - O);
+        
+        for(size_t i = 0; i != O; ++i)
+            update(size - O + i, size - O + i + 1);
+    }
+    
+    // counts an activation, false once frozen code has run it
+    bool thaw() {
+        ne_count(ne_activations, 1);
+        ne_count(ne_links_traversed, sources.size());
+        
+        if(frozen != nullptr) {
+            frozen->activate(values.data());
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // nodes [first, last) in position order
+    void update(size_t first, size_t last) {
+        double* v = values.data();
+        const size_t* o = offsets.data();
+        const size_t* s = sources.data();
+        const double* w = weights.data();
+        
+        if(accuracy == ne_exact) {
+            for(size_t i = first; i != last; ++i) {
+                double sum = 0.0;
+                
+                for(size_t k = o[i]; k != o[i + 1]; ++k)
+                    sum += w[k] * v[s[k]];
+                
+                v[i] = tanh(sum);
+            }
+        }else{
+            for(size_t i = first; i != last; ++i) {
+                size_t n = o[i + 1] - o[i];
+                double sum = n < 4 ? ne_dot_scalar(w + o[i], s + o[i], v, n) : kernels->dot(w + o[i], s + o[i], v, n);
+                v[i] = ne_fast_tanh(sum);
+            }
+        }
+    }
+    
+    // lanes independent, flushed copies of the network: node i of lane q is batch[i * lanes + q]
+    void flush(size_t n) {
+        lanes = n;
+        batch.assign((offsets.size() - 1) * n, 0.0);
+        sums.resize(n);
+    }
+    
+    double* row(size_t i) {
+        return batch.data() + i * lanes;
+    }
+    
+    // one activation of the first n lanes
+    void step(size_t n) {
+        if(thaw(n)) update(input_size, size(), n);
+    }
+    
+    template <size_t I, size_t O>
+    void step(size_t n) {
+        assert(input_size == I && output_size == O);
+        if(!thaw(n)) return;
+        
+        size_t size = this->size();
+        update(I, size - O, n);
+        
+        for(size_t i = 0; i != O; ++i)
+            update(size - O + i, size - O + i + 1, n);
+    }
+    
+    // counts a step of n lanes, false once frozen code has run it
+    bool thaw(size_t n) {
+        ne_count(ne_activations, n);
+        ne_count(ne_links_traversed, n * sources.size());
+        
+        if(frozen != nullptr) {
+            frozen->step(batch.data(), lanes, n);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // nodes [first, last) of the first n lanes
+    void update(size_t first, size_t last, size_t n) {
+        double* v = batch.data();
+        double* t = sums.data();
+        const size_t* o = offsets.data();
+        const size_t* s = sources.data();
+        const double* w = weights.data();
+        
+        for(size_t i = first; i != last; ++i) {
+            std::fill(t, t + n, 0.0);
+            
+            for(size_t k = o[i]; k != o[i + 1]; ++k)
+                kernels->axpy(t, w[k], v + s[k] * lanes, n);
+            
+            kernels->tanh(v + i * lanes, t, n);
+        }
+    }
+    
+    void move_lane(size_t a, size_t b) {
+        size_t size = offsets.size() - 1;
+        
+        for(size_t i = 0; i != size; ++i)
+            batch[i * lanes + b] = batch[i * lanes + a];
+    }
+    
+    // n samples in one pass, each from a flushed network: in is n x input_size, out is n x output_size
+    void activate(const double* in, double* out, size_t n) {
+        flush(n);
+        
+        for(size_t i = 0; i != input_size; ++i) {
+            double* y = row(i);
+            
+            for(size_t q = 0; q != n; ++q)
+                y[q] = in[q * input_size + i];
+        }
+        
+        step(n);
+        
+        size_t size = offsets.size() - 1;
+        
+        for(size_t i = 0; i != output_size; ++i) {
+            const double* y = row(size - output_size + i);
+            
+            for(size_t q = 0; q != n; ++q)
+                out[q * output_size + i] = y[q];
+        }
+    }
+    
+    // the same, a sample at a time, for I inputs and O outputs
+    template <size_t I, size_t O>
+    void activate(const double* in, double* out, size_t n) {
+        assert(input_size == I && output_size == O);
+        flush(n);
+        
+        double* v = batch.data();
+        
+        for(size_t q = 0; q != n; ++q) {
+            for(size_t i = 0; i != I; ++i)
+                v[i * n + q] = in[q * I + i];
+        }
+        
+        step<I, O>(n);
+        
+        const double* y = row(size() - O);
+        
+        for(size_t q = 0; q != n; ++q) {
+            for(size_t i = 0; i != O; ++i)
+                out[q * O + i] = y[i * n + q];
+        }
+    }
+};
+
+#endif /* network_h */
@@ -9,110 +9,589 @@
 #ifndef population_h
 #define population_h
 
-#include "genome.h"
+#include "species.h"
+#include "scheduler.h"
 #include <iostream>
+#include <string>
 
 struct ne_settings {
     double mutate_add_prob;
+    
+    // genomes further apart than this fall in different species, 0 for no speciation
+    double species_distance;
+    
     size_t population;
+    uint64_t seed;
+    ne_accuracy accuracy;
+    bool cache;
+    
+    // generations between compaction passes, 0 for none
+    size_t compact;
+    
+    // generations between checkpoints, 0 for none
+    size_t checkpoint;
+    
+    // islands processes evolve apart, each sending its best migrants to the next every migrate generations.
+    // island is this process's number, given out when the processes start
+    size_t islands;
+    size_t island;
+    size_t migrate;
+    size_t migrants;
+    
+    // worker processes to evaluate on, 0 to evaluate in this one, and genomes per message to them
+    size_t farm;
+    size_t batch;
+    
+    // name of the task to evolve on
+    std::string task;
+    
+    // replay the best genome on code built for it
+    bool jit;
     
     ne_settings() {}
     
-    ne_settings(double mutate_add_prob, double species_distance, size_t population) : mutate_add_prob(mutate_add_prob), population(population) {}
+    ne_settings(double mutate_add_prob, double species_distance, size_t population) : mutate_add_prob(mutate_add_prob), species_distance(species_distance), population(population), seed(ne_seed()), accuracy(ne_exact), cache(false), compact(0), checkpoint(0), islands(1), island(0), migrate(0), migrants(0), farm(0), batch(16), task("DIR"), jit(false) {}
     
-    ne_settings(std::ifstream& is) {
+    // the mutation probability and the population size, then any number of "name value" pairs
+    ne_settings(std::ifstream& is) : species_distance(0.0), seed(ne_seed()), accuracy(ne_exact), cache(false), compact(0), checkpoint(0), islands(1), island(0), migrate(0), migrants(0), farm(0), batch(16), task("DIR"), jit(false) {
         is >> mutate_add_prob >> population;
+        
+        std::string name;
+        while(is >> name) {
+            if(name == "seed") {
+                is >> seed;
+            }else if(name == "accuracy") {
+                std::string value;
+                is >> value;
+                accuracy = value == "fast" ? ne_fast : ne_exact;
+            }else if(name == "cache") {
+                is >> cache;
+            }else if(name == "compact") {
+                is >> compact;
+            }else if(name == "checkpoint") {
+                is >> checkpoint;
+            }else if(name == "species") {
+                is >> species_distance;
+            }else if(name == "islands") {
+                is >> islands;
+            }else if(name == "migrate") {
+                is >> migrate;
+            }else if(name == "migrants") {
+                is >> migrants;
+            }else if(name == "farm") {
+                is >> farm;
+            }else if(name == "batch") {
+                is >> batch;
+            }else if(name == "task") {
+                is >> task;
+            }else if(name == "jit") {
+                is >> jit;
+            }else{
+                std::cerr << "unknown setting: " << name << '\n';
+                is >> name;
+            }
+        }
     }
 };
 
+// bytes held by a population. blocks shared with genomes outside it, such as a pending snapshot, count in part
+struct ne_memory {
+    // in the current generation, not the slots kept for the next
+    size_t genomes;
+    size_t blocks;
+    size_t bytes;
+};
+
+// picks the constructor of ne_population that copies only what a checkpoint writes
+struct ne_snapshot {};
+
 struct ne_population {
     double fitness;
     
     ne_settings settings;
+    
+    // two generations of genomes in one allocation, never resized: the current one in genomes,
+    // the previous one in spare as storage for the next. a snapshot only has the current one
+    std::vector<ne_genome> storage;
+    
     std::vector<ne_genome*> genomes;
+    std::vector<ne_genome*> spare;
     
-    ne_population(const ne_settings& _settings, size_t input_size, size_t output_size) : settings(_settings) {
-        genomes.resize(settings.population);
-        
-        for(ne_genome*& g : genomes) {
-            g = new ne_genome(input_size, output_size);
-            g->mutate_add_link();
-        }
-    }
+    // the parent of each child of the next generation, and scratch for picking the best genomes
+    std::vector<ne_genome*> parents;
+    std::vector<ne_genome*> ranked;
+    
+    size_t generation;
+    
+    // removed by the last compaction pass
+    ne_compaction pruned;
+    
+    // empty without speciation
+    std::vector<ne_species> species;
+    
+    // distances computed by the last speciate()
+    size_t comparisons;
     
-    ne_population(const ne_population& population) : settings(population.settings) {
-        genomes.resize(settings.population);
+    ne_population(const ne_settings& _settings, size_t input_size, size_t output_size) : settings(_settings), generation(0), comparisons(0) {
+        storage.reserve(2 * settings.population);
         
         for(size_t i = 0; i != settings.population; ++i) {
-            genomes[i] = new ne_genome(*population.genomes[i]);
+            storage.emplace_back(input_size, output_size);
+            storage.back().mutate_add_link();
+            genomes.push_back(&storage.back());
         }
+        
+        allocate(input_size, output_size);
+    }
+    
+    // an exact copy, cheap since the genomes share their blocks with the originals
+    ne_population(const ne_population& population) : fitness(population.fitness), settings(population.settings), generation(population.generation), pruned(population.pruned), species(population.species), comparisons(population.comparisons) {
+        share(population, 2 * settings.population);
+        allocate(genomes.front()->input_size, genomes.front()->output_size);
     }
     
-    ne_population(std::ifstream& is) {
-        is.read((char*)&settings, sizeof(settings));
-        genomes.resize(settings.population);
-        for(ne_genome*& g : genomes)
-            g = new ne_genome(is);
+    // only what write() needs, without the spare generation, so it can be written but not reproduced
+    ne_population(const ne_population& population, ne_snapshot) : fitness(population.fitness), settings(population.settings), generation(population.generation), pruned(population.pruned), species(population.species), comparisons(population.comparisons) {
+        share(population, population.genomes.size());
+    }
+    
+    // resumes the calling thread's stream where the checkpoint left it, fails r if the checkpoint doesn't read back whole
+    ne_population(ne_reader& r) : comparisons(0) {
+        size_t words = r.begin();
+        
+        settings.mutate_add_prob = r.real();
+        settings.species_distance = r.real();
+        settings.population = r.word();
+        settings.seed = r.word();
+        settings.accuracy = (ne_accuracy)r.word();
+        settings.cache = r.word() != 0;
+        settings.compact = r.word();
+        settings.checkpoint = r.word();
+        settings.islands = r.word();
+        settings.island = r.word();
+        settings.migrate = r.word();
+        settings.migrants = r.word();
+        settings.farm = r.word();
+        settings.batch = r.word();
+        settings.task = r.text();
+        settings.jit = r.word() != 0;
+        
+        generation = r.word();
+        
+        ne_rng rng;
+        for(int k = 0; k < 4; ++k)
+            rng.s[k] = r.word();
+        
+        if(words != 20 + ne_text_words(settings.task) || !r.end()) {
+            r.good = false;
+            return;
+        }
+        
+        ne_seed() = settings.seed;
+        ne_generator = rng;
+        
+        // counts are checked against the words left in the record before anything is sized by them,
+        // since the checksum is only known at the end
+        words = r.begin();
+        size_t count = r.word();
+        
+        if(words == 0 || count > words - 1) {
+            r.good = false;
+            return;
+        }
+        
+        species.resize(count);
+        
+        size_t read = 1;
+        for(ne_species& sp : species) {
+            count = r.word();
+            
+            if(read >= words || count > (words - read - 1) / 2) {
+                r.good = false;
+                return;
+            }
+            
+            read += 1 + 2 * count;
+            
+            sp.representative.reset(count);
+            
+            for(size_t n = 0; n != count; ++n) {
+                uint64_t key = r.word();
+                sp.representative.insert(key, r.real());
+            }
+        }
+        
+        if(read != words || !r.end()) {
+            r.good = false;
+            return;
+        }
+        
+        // a genome's record takes at least eight words, with its length and checksum
+        if(settings.population == 0 || settings.population > r.remaining / 8) {
+            r.good = false;
+            return;
+        }
+        
+        storage.reserve(2 * settings.population);
+        
+        // every genome of a population has the same inputs and outputs
+        while(r.good && genomes.size() != settings.population) {
+            storage.emplace_back(r);
+            genomes.push_back(&storage.back());
+            
+            if(genomes.back()->input_size != genomes.front()->input_size || genomes.back()->output_size != genomes.front()->output_size)
+                r.good = false;
+        }
+        
+        if(r.good) allocate(genomes.front()->input_size, genomes.front()->output_size);
     }
     
     ne_population& operator = (const ne_population& population) = delete;
     
-    ~ne_population() {
-        for(ne_genome* g : genomes)
-            delete g;
+    // the genomes of population, into storage reserved for capacity of them
+    void share(const ne_population& population, size_t capacity) {
+        const ne_genome* first = population.genomes.front();
+        
+        storage.reserve(capacity);
+        
+        for(const ne_genome* g : population.genomes) {
+            storage.emplace_back(first->input_size, first->output_size);
+            storage.back().share(*g);
+            genomes.push_back(&storage.back());
+        }
+    }
+    
+    // the spare generation, after the current one in storage, up to the two generations reserved.
+    // reserve may give more capacity than asked for, and whatever is past the reservation stays unused
+    void allocate(size_t input_size, size_t output_size) {
+        while(storage.size() != 2 * settings.population) {
+            storage.emplace_back(input_size, output_size);
+            spare.push_back(&storage.back());
+        }
     }
     
+    // the best genome, leaving the order of genomes alone
     ne_genome* analyse() {
+        ne_time(ne_analyse_phase);
+        
         fitness = 0.0;
         
+        ne_genome* best = genomes.front();
+        
         for(ne_genome* g : genomes) {
             g->fitness = fmax(0.0, g->fitness);
             fitness += g->fitness;
+            
+            if(g->fitness > best->fitness)
+                best = g;
         }
         
-        std::sort(genomes.begin(), genomes.end(), [] (ne_genome* a, ne_genome* b) {
-            return a->fitness > b->fitness;
+        return best;
+    }
+    
+    // runs job(worker, task) for every task in [0, count), on scheduler if there is one
+    static void each(ne_scheduler* scheduler, size_t count, const ne_scheduler::job_type& job) {
+        if(scheduler == nullptr) {
+            for(size_t i = 0; i != count; ++i)
+                job(0, i);
+        }else{
+            scheduler->run(count, job);
+        }
+    }
+    
+    // children are bred in parallel, each mutating on a stream keyed by the generation and its index,
+    // so the next generation comes out the same however the work is split
+    void reproduce(ne_scheduler* scheduler = nullptr) {
+        select();
+        
+        each(scheduler, parents.size(), [this] (size_t, size_t i) {
+            breed(i);
         });
         
-        return genomes.front();
+        genomes.swap(spare);
+        
+        ++generation;
+        
+        if(settings.compact != 0 && generation % settings.compact == 0)
+            pruned = compact(scheduler);
     }
     
-    void reproduce() {
-        std::vector<ne_genome*> babies;
+    // picks the parent of every child: offspring in proportion to fitness, with the ones lost to rounding
+    // going to the best genomes, one each
+    void select() {
+        ne_time(ne_select_phase);
         
-        size_t sum = settings.population;
+        parents.clear();
         
-        if(fitness != 0.0) {
+        if(settings.species_distance > 0.0) {
+            speciate();
+            share();
+        }else if(fitness != 0.0) {
             for(ne_genome* g : genomes) {
                 size_t offsprings = (size_t)floor(settings.population * g->fitness / fitness);
-                for(size_t n = 0; n != offsprings; ++n)
-                    babies.push_back(breed(g));
-                sum -= offsprings;
+                parents.insert(parents.end(), offsprings, g);
             }
         }
         
-        size_t i = 0;
-        while(sum-- != 0) {
-            babies.push_back(breed(genomes[i]));
-            ++i;
+        if(parents.size() > settings.population)
+            parents.resize(settings.population);
+        
+        size_t sum = settings.population - parents.size();
+        
+        ranked = genomes;
+        
+        if(sum < ranked.size()) {
+            std::nth_element(ranked.begin(), ranked.begin() + sum, ranked.end(), [] (ne_genome* a, ne_genome* b) {
+                return a->fitness > b->fitness;
+            });
         }
         
-        for(ne_genome* g : genomes)
-            delete g;
+        parents.insert(parents.end(), ranked.begin(), ranked.begin() + sum);
+    }
+    
+    // puts every genome in the first species whose representative is close enough, trying the species of
+    // its parent first since that is nearly always where it lands, then picks the best members as the new
+    // representatives and shares fitness within each species
+    void speciate() {
+        size_t size = genomes.size();
+        comparisons = 0;
+        
+        for(ne_species& sp : species)
+            sp.members.clear();
+        
+        for(size_t i = 0; i != size; ++i) {
+            size_t home = genomes[i]->species;
+            size_t found = species.size();
+            
+            if(home < species.size() && close(i, home)) {
+                found = home;
+            }else{
+                for(size_t k = 0; k != species.size(); ++k) {
+                    if(k != home && close(i, k)) {
+                        found = k;
+                        break;
+                    }
+                }
+            }
+            
+            if(found == species.size()) {
+                species.emplace_back();
+                species.back().representative.assign(*genomes[i]);
+            }
+            
+            species[found].members.push_back(i);
+        }
+        
+        species.erase(std::remove_if(species.begin(), species.end(), [] (const ne_species& sp) {
+            return sp.members.empty();
+        }), species.end());
+        
+        for(size_t k = 0; k != species.size(); ++k) {
+            ne_species& sp = species[k];
+            ne_genome* best = genomes[sp.members.front()];
+            sp.fitness = 0.0;
+            
+            for(size_t m : sp.members) {
+                genomes[m]->species = k;
+                sp.fitness += genomes[m]->fitness;
+                
+                if(genomes[m]->fitness > best->fitness)
+                    best = genomes[m];
+            }
+            
+            sp.representative.assign(*best);
+            sp.fitness /= sp.members.size();
+        }
+    }
+    
+    bool close(size_t i, size_t k) {
+        ++comparisons;
+        return ne_distance(*genomes[i], species[k].representative, settings.species_distance) <= settings.species_distance;
+    }
+    
+    // offspring for each species in proportion to its shared fitness, then for each member in proportion to its own
+    void share() {
+        double total = 0.0;
+        for(const ne_species& sp : species)
+            total += sp.fitness;
+        
+        if(total == 0.0) return;
+        
+        for(const ne_species& sp : species) {
+            size_t offsprings = (size_t)floor(settings.population * sp.fitness / total);
+            double sum = sp.fitness * sp.members.size();
+            size_t left = offsprings;
+            
+            if(sum != 0.0) {
+                for(size_t m : sp.members) {
+                    size_t n = (size_t)floor(offsprings * genomes[m]->fitness / sum);
+                    parents.insert(parents.end(), n, genomes[m]);
+                    left -= n;
+                }
+            }
+            
+            for(size_t k = 0; left != 0; ++k, --left)
+                parents.push_back(genomes[sp.members[k % sp.members.size()]]);
+        }
+    }
+    
+    ne_compaction compact(ne_scheduler* scheduler = nullptr) {
+        std::vector<ne_compaction> totals(scheduler == nullptr ? 1 : scheduler->size());
+        
+        each(scheduler, genomes.size(), [this, &totals] (size_t w, size_t i) {
+            ne_time(ne_compact_phase);
+            totals[w] += genomes[i]->compact();
+        });
+        
+        ne_compaction total;
+        for(const ne_compaction& c : totals)
+            total += c;
+        return total;
+    }
+    
+    // the count best genomes, in no particular order
+    void best(size_t count, std::vector<ne_genome*>& out) {
+        ranked = genomes;
+        count = std::min(count, ranked.size());
+        
+        std::nth_element(ranked.begin(), ranked.begin() + count, ranked.end(), [] (ne_genome* a, ne_genome* b) {
+            return a->fitness > b->fitness;
+        });
+        
+        out.assign(ranked.begin(), ranked.begin() + count);
+    }
+    
+    // copies migrants, fitness and all, over the worst genomes. call between analyse() and reproduce()
+    void immigrate(const std::vector<ne_genome>& migrants) {
+        size_t count = std::min(migrants.size(), genomes.size());
+        if(count == 0) return;
+        
+        ranked = genomes;
+        
+        std::nth_element(ranked.begin(), ranked.end() - count, ranked.end(), [] (ne_genome* a, ne_genome* b) {
+            return a->fitness > b->fitness;
+        });
+        
+        for(size_t k = 0; k != count; ++k) {
+            ne_genome* g = ranked[ranked.size() - count + k];
+            if(migrants[k].input_size != g->input_size || migrants[k].output_size != g->output_size) continue;
+            
+            fitness -= g->fitness;
+            
+            g->copy(migrants[k]);
+            g->fitness = fmax(0.0, migrants[k].fitness);
+            g->species = species.size();
+            fitness += g->fitness;
+        }
+    }
+    
+    // the i-th child of the next generation, into the i-th spare genome
+    void breed(size_t i) {
+        ne_rng_scope scope(ne_stream(ne_mutation_stream, generation, i));
+        
+        // the genome being overwritten lets go of its blocks first, so freeing is timed on its own
+        {
+            ne_time(ne_free_phase);
+            spare[i]->links.clear();
+        }
+        
+        {
+            ne_time(ne_clone_phase);
+            spare[i]->copy(*parents[i]);
+        }
+        
+        ne_time(ne_mutate_phase);
+        spare[i]->mutate(settings.mutate_add_prob);
+    }
+    
+    ne_memory memory() const {
+        ne_memory m;
+        m.genomes = genomes.size();
         
-        genomes = babies;
+        double blocks = 0.0;
+        size_t bytes = storage.capacity() * sizeof(ne_genome) + (genomes.capacity() + spare.capacity() + parents.capacity() + ranked.capacity()) * sizeof(ne_genome*);
+        
+        for(const ne_genome& g : storage) {
+            bytes += g.links.blocks.capacity() * sizeof(ne_link_array::block_pointer) + g.links.index.capacity() * sizeof(uint32_t);
+            
+            for(const ne_link_array::block_pointer& b : g.links.blocks)
+                blocks += 1.0 / b.use_count();
+        }
+        
+        for(const ne_species& sp : species)
+            bytes += sizeof(ne_species) + sp.representative.keys.capacity() * (sizeof(uint64_t) + sizeof(double)) + sp.members.capacity() * sizeof(size_t);
+        
+        m.blocks = (size_t)round(blocks);
+        m.bytes = bytes + m.blocks * sizeof(ne_link_block);
+        return m;
     }
     
-    ne_genome* breed(ne_genome* g) {
-        ne_genome* baby = new ne_genome(*g);
-        baby->mutate(settings.mutate_add_prob);
-        return baby;
+    void write(ne_writer& w) const {
+        write(w, ne_generator);
     }
     
-    void write(std::ofstream& os) const {
-        os.write((char*)&settings, sizeof(settings));
+    // the settings, the generation and the calling thread's stream, then one record per genome
+    void write(ne_writer& w, const ne_rng& stream) const {
+        w.begin(20 + ne_text_words(settings.task));
+        
+        w.real(settings.mutate_add_prob);
+        w.real(settings.species_distance);
+        w.word(settings.population);
+        w.word(settings.seed);
+        w.word(settings.accuracy);
+        w.word(settings.cache);
+        w.word(settings.compact);
+        w.word(settings.checkpoint);
+        w.word(settings.islands);
+        w.word(settings.island);
+        w.word(settings.migrate);
+        w.word(settings.migrants);
+        w.word(settings.farm);
+        w.word(settings.batch);
+        w.text(settings.task);
+        w.word(settings.jit);
+        
+        w.word(generation);
+        
+        for(int k = 0; k < 4; ++k)
+            w.word(stream.s[k]);
+        
+        w.end();
+        
+        size_t words = 1;
+        for(const ne_species& sp : species)
+            words += 1 + 2 * sp.representative.size;
+        
+        w.begin(words);
+        w.word(species.size());
+        
+        // genes go out in key order, since where a key lands in the table depends on what went in before it,
+        // and a table read back must write the same words as the one it was read from
+        std::vector<size_t> order;
+        
+        for(const ne_species& sp : species) {
+            const ne_genes& genes = sp.representative;
+            w.word(genes.size);
+            
+            order.clear();
+            for(size_t b = 0; b != genes.keys.size(); ++b) {
+                if(genes.keys[b] != ne_genes::empty) order.push_back(b);
+            }
+            
+            std::sort(order.begin(), order.end(), [&genes] (size_t a, size_t b) {
+                return genes.keys[a] < genes.keys[b];
+            });
+            
+            for(size_t b : order) {
+                w.word(genes.keys[b]);
+                w.real(genes.weights[b]);
+            }
+        }
+        
+        w.end();
+        
         for(ne_genome* g : genomes)
-            g->write(os);
+            g->write(w);
     }
     
 };
@@ -0,0 +1,153 @@
+//
+//  profile.h
+//  NE
+//
+//  Created by Arthur Sun on 9/30/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef profile_h
+#define profile_h
+
+#include <cstdint>
+#include <cstddef>
+
+// time spent in each phase and counts of hot-path events, kept per thread and summed by ne_profile().
+// only built with NE_PROFILE defined; otherwise ne_time and ne_count are empty and cost nothing.
+// phases run on the scheduler's workers add up across threads, so they are cpu time rather than wall time
+
+enum ne_phase {
+    ne_evaluate_phase,
+    ne_analyse_phase,
+    ne_select_phase,
+    ne_clone_phase,
+    ne_mutate_phase,
+    ne_free_phase,
+    ne_compact_phase,
+    ne_phases
+};
+
+enum ne_event {
+    ne_activations,
+    ne_links_traversed,
+    ne_allocations,
+    ne_events
+};
+
+struct ne_profile_counters {
+    uint64_t nanoseconds[ne_phases];
+    uint64_t events[ne_events];
+    
+    ne_profile_counters() {
+        for(uint64_t& t : nanoseconds) t = 0;
+        for(uint64_t& e : events) e = 0;
+    }
+};
+
+#ifdef NE_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <ostream>
+
+// each thread only ever adds to its own counters, so relaxed loads and stores are enough, and the report
+// reads them between generations while the workers are idle
+struct ne_profile_slot {
+    std::atomic<uint64_t> nanoseconds[ne_phases];
+    std::atomic<uint64_t> events[ne_events];
+    
+    ne_profile_slot() {
+        for(std::atomic<uint64_t>& t : nanoseconds) t.store(0);
+        for(std::atomic<uint64_t>& e : events) e.store(0);
+    }
+};
+
+inline void ne_profile_add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline std::mutex& ne_profile_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// every thread's slot. slots are never freed, so a thread that has exited is still counted
+inline std::vector<ne_profile_slot*>& ne_profile_slots() {
+    static std::vector<ne_profile_slot*> slots;
+    return slots;
+}
+
+inline ne_profile_slot& ne_profile_local() {
+    static thread_local ne_profile_slot* slot = nullptr;
+    
+    if(slot == nullptr) {
+        slot = new ne_profile_slot();
+        std::lock_guard<std::mutex> lock(ne_profile_mutex());
+        ne_profile_slots().push_back(slot);
+    }
+    
+    return *slot;
+}
+
+struct ne_profile_timer {
+    ne_phase phase;
+    std::chrono::steady_clock::time_point start;
+    
+    ne_profile_timer(ne_phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+    
+    ~ne_profile_timer() {
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+        ne_profile_add(ne_profile_local().nanoseconds[phase], elapsed.count());
+    }
+};
+
+// the totals since the last call, over all threads
+inline ne_profile_counters ne_profile() {
+    ne_profile_counters c;
+    std::lock_guard<std::mutex> lock(ne_profile_mutex());
+    
+    for(ne_profile_slot* slot : ne_profile_slots()) {
+        for(size_t p = 0; p != ne_phases; ++p)
+            c.nanoseconds[p] += slot->nanoseconds[p].exchange(0, std::memory_order_relaxed);
+        
+        for(size_t e = 0; e != ne_events; ++e)
+            c.events[e] += slot->events[e].exchange(0, std::memory_order_relaxed);
+    }
+    
+    return c;
+}
+
+// one line of json: the generation, milliseconds in each phase and the event counts
+inline void ne_profile_report(std::ostream& os, size_t generation) {
+    static const char* phases[ne_phases] = { "evaluate", "analyse", "select", "clone", "mutate", "free", "compact" };
+    static const char* events[ne_events] = { "activations", "links", "allocations" };
+    
+    ne_profile_counters c = ne_profile();
+    
+    os << "profile: {\"generation\":" << generation;
+    
+    for(size_t p = 0; p != ne_phases; ++p)
+        os << ",\"" << phases[p] << "_ms\":" << c.nanoseconds[p] * 1e-6;
+    
+    for(size_t e = 0; e != ne_events; ++e)
+        os << ",\"" << events[e] << "\":" << c.events[e];
+    
+    os << "}\n";
+}
+
+#define ne_profile_concat2(a, b) a##b
+#define ne_profile_concat(a, b) ne_profile_concat2(a, b)
+
+#define ne_time(phase) ne_profile_timer ne_profile_concat(ne_timer_, __LINE__)(phase)
+#define ne_count(event, n) ne_profile_add(ne_profile_local().events[event], (n))
+
+#else
+
+#define ne_time(phase)
+#define ne_count(event, n)
+
+#endif
+
+#endif /* profile_h */
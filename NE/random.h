@@ -0,0 +1,155 @@
+//
+//  random.h
+//  NE
+//
+//  Created by Arthur Sun on 9/16/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef random_h
+#define random_h
+
+#include <cstdint>
+#include <chrono>
+#include <type_traits>
+
+// xoshiro256**: 32 bytes of state, so streams are cheap to hand out and to copy around
+
+inline uint64_t ne_mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+struct ne_rng {
+    uint64_t s[4];
+    
+    constexpr ne_rng() : s{0x9e3779b97f4a7c15, 0xbf58476d1ce4e5b9, 0x94d049bb133111eb, 0x2545f4914f6cdd1d} {}
+    
+    explicit ne_rng(uint64_t key) {
+        seed(key);
+    }
+    
+    void seed(uint64_t key) {
+        for(int k = 0; k < 4; ++k) {
+            s[k] = ne_mix(key);
+            key += 0x9e3779b97f4a7c15;
+        }
+    }
+    
+    static inline uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+    
+    inline uint64_t next() {
+        uint64_t r = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        
+        return r;
+    }
+    
+    // advances the stream by 2^128 draws
+    void jump() {
+        static const uint64_t table[4] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        
+        uint64_t t[4] = {0, 0, 0, 0};
+        
+        for(int i = 0; i < 4; ++i) {
+            for(int b = 0; b < 64; ++b) {
+                if(table[i] & (uint64_t(1) << b)) {
+                    for(int k = 0; k < 4; ++k)
+                        t[k] ^= s[k];
+                }
+                
+                next();
+            }
+        }
+        
+        for(int k = 0; k < 4; ++k)
+            s[k] = t[k];
+    }
+    
+    // [0, 1)
+    inline double uniform() {
+        return (next() >> 11) * 0x1p-53;
+    }
+    
+    // [0, n), Lemire's multiply-shift with rejection only on the biased sliver
+    inline uint64_t below(uint64_t n) {
+        __uint128_t m = (__uint128_t)next() * n;
+        uint64_t l = (uint64_t)m;
+        
+        if(l < n) {
+            uint64_t t = -n % n;
+            while(l < t) {
+                m = (__uint128_t)next() * n;
+                l = (uint64_t)m;
+            }
+        }
+        
+        return (uint64_t)(m >> 64);
+    }
+};
+
+enum {
+    ne_thread_stream,
+    ne_evaluation_stream,
+    ne_episode_stream,
+    ne_mutation_stream
+};
+
+inline uint64_t& ne_seed() {
+    static uint64_t seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return seed;
+}
+
+// current stream of the calling thread, everything in ne_random draws from it
+static thread_local ne_rng ne_generator;
+
+inline ne_rng ne_stream(uint64_t domain, uint64_t a, uint64_t b = 0) {
+    return ne_rng(ne_mix(ne_mix(ne_mix(ne_seed() ^ domain) ^ a) ^ b));
+}
+
+inline void ne_reseed(uint64_t seed) {
+    ne_seed() = seed;
+    ne_generator = ne_stream(ne_thread_stream, 0);
+}
+
+// makes rng the calling thread's stream until the end of the scope
+struct ne_rng_scope {
+    ne_rng saved;
+    
+    ne_rng_scope(const ne_rng& rng) : saved(ne_generator) {
+        ne_generator = rng;
+    }
+    
+    ~ne_rng_scope() {
+        ne_generator = saved;
+    }
+};
+
+// [a, b] for integers, [a, b) for reals
+template <class T>
+inline T ne_random(T a, T b, std::true_type) {
+    return a + (T)ne_generator.below((uint64_t)(b - a) + 1);
+}
+
+template <class T>
+inline T ne_random(T a, T b, std::false_type) {
+    return a + (b - a) * (T)ne_generator.uniform();
+}
+
+template <class T>
+inline T ne_random(T a, T b) {
+    return ne_random(a, b, std::is_integral<T>());
+}
+
+#endif /* random_h */
@@ -0,0 +1,151 @@
+//
+//  scheduler.h
+//  NE
+//
+//  Created by Arthur Sun on 9/15/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+// runs job(worker, task) for every task in [0, count) on a fixed set of workers;
+// each worker starts with a contiguous range and steals half of a victim's range once its own runs dry
+
+struct ne_scheduler {
+    typedef std::function<void(size_t, size_t)> job_type;
+    
+    struct range {
+        std::mutex mutex;
+        size_t begin;
+        size_t end;
+        
+        range() : begin(0), end(0) {}
+    };
+    
+    std::vector<range> ranges;
+    std::vector<std::thread> threads;
+    
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    
+    const job_type* job;
+    size_t epoch;
+    size_t busy;
+    bool quit;
+    
+    ne_scheduler(size_t size) : ranges(size == 0 ? 1 : size), job(nullptr), epoch(0), busy(0), quit(false) {
+        for(size_t w = 1; w < ranges.size(); ++w)
+            threads.emplace_back(&ne_scheduler::loop, this, w);
+    }
+    
+    ne_scheduler(const ne_scheduler& scheduler) = delete;
+    
+    ne_scheduler& operator = (const ne_scheduler& scheduler) = delete;
+    
+    ~ne_scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        
+        wake.notify_all();
+        
+        for(std::thread& thread : threads)
+            thread.join();
+    }
+    
+    size_t size() const {
+        return ranges.size();
+    }
+    
+    void run(size_t count, const job_type& f) {
+        size_t size = ranges.size();
+        
+        for(size_t w = 0; w != size; ++w) {
+            std::lock_guard<std::mutex> lock(ranges[w].mutex);
+            ranges[w].begin = count * w / size;
+            ranges[w].end = count * (w + 1) / size;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &f;
+            busy = size - 1;
+            ++epoch;
+        }
+        
+        wake.notify_all();
+        
+        work(0);
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+    
+    void loop(size_t w) {
+        size_t seen = 0;
+        
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || epoch != seen; });
+                if(quit) return;
+                seen = epoch;
+            }
+            
+            work(w);
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--busy == 0) done.notify_one();
+        }
+    }
+    
+    void work(size_t w) {
+        size_t task;
+        while(pop(w, task) || steal(w, task))
+            (*job)(w, task);
+    }
+    
+    bool pop(size_t w, size_t& task) {
+        std::lock_guard<std::mutex> lock(ranges[w].mutex);
+        if(ranges[w].begin == ranges[w].end) return false;
+        task = ranges[w].begin++;
+        return true;
+    }
+    
+    bool steal(size_t w, size_t& task) {
+        size_t size = ranges.size();
+        
+        for(size_t k = 1; k < size; ++k) {
+            range& victim = ranges[(w + k) % size];
+            size_t begin, end;
+            
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if(victim.begin == victim.end) continue;
+                begin = victim.begin + (victim.end - victim.begin) / 2;
+                end = victim.end;
+                victim.end = begin;
+            }
+            
+            std::lock_guard<std::mutex> lock(ranges[w].mutex);
+            ranges[w].begin = begin + 1;
+            ranges[w].end = end;
+            task = begin;
+            return true;
+        }
+        
+        return false;
+    }
+};
+
+#endif /* scheduler_h */
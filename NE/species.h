@@ -0,0 +1,123 @@
+//
+//  species.h
+//  NE
+//
+//  Created by Arthur Sun on 9/26/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef species_h
+#define species_h
+
+#include "genome.h"
+
+// links have no innovation numbers, so a link's key stands in for its gene: two genomes share a gene
+// when both have an enabled link between the same pair of nodes
+
+// weights of a genome's enabled links by key, in an open addressing table at most half full,
+// bucketed by the top bits of a multiplicative hash
+struct ne_genes {
+    static const uint64_t empty = ~(uint64_t)0;
+    
+    std::vector<uint64_t> keys;
+    std::vector<double> weights;
+    size_t size;
+    int shift;
+    
+    ne_genes() : size(0), shift(64) {}
+    
+    size_t bucket(uint64_t key) const {
+        return (size_t)((key * 0x9e3779b97f4a7c15) >> shift);
+    }
+    
+    void reset(size_t count) {
+        size_t capacity = 16;
+        shift = 60;
+        
+        while(capacity < 2 * count) {
+            capacity *= 2;
+            --shift;
+        }
+        
+        keys.assign(capacity, uint64_t(empty));
+        weights.resize(capacity);
+        size = 0;
+    }
+    
+    void assign(const ne_genome& genome) {
+        reset(genome.links.size() - genome.disabled);
+        
+        for(const ne_link& link : genome.links) {
+            if(link.weight != 0.0) insert(link.key(), link.weight);
+        }
+    }
+    
+    void insert(uint64_t key, double weight) {
+        size_t mask = keys.size() - 1;
+        size_t b = bucket(key);
+        
+        while(keys[b] != empty)
+            b = (b + 1) & mask;
+        
+        keys[b] = key;
+        weights[b] = weight;
+        ++size;
+    }
+    
+    const double* find(uint64_t key) const {
+        size_t mask = keys.size() - 1;
+        
+        for(size_t b = bucket(key); keys[b] != empty; b = (b + 1) & mask) {
+            if(keys[b] == key) return &weights[b];
+        }
+        
+        return nullptr;
+    }
+};
+
+// genes in only one of them over the size of the larger, plus the mean weight difference of the genes in both.
+// one pass over the genome's links, stopping as soon as the distance can only end up past limit
+inline double ne_distance(const ne_genome& genome, const ne_genes& genes, double limit) {
+    static const double weight_coefficient = 0.4;
+    
+    size_t size = genome.links.size() - genome.disabled;
+    
+    double n = (double)std::max(std::max(size, genes.size), (size_t)1);
+    size_t bound = (size_t)(limit * n);
+    
+    size_t only = 0;
+    size_t matching = 0;
+    double difference = 0.0;
+    
+    for(const ne_link& link : genome.links) {
+        if(link.weight == 0.0) continue;
+        
+        const double* weight = genes.find(link.key());
+        
+        if(weight != nullptr) {
+            difference += fabs(link.weight - *weight);
+            ++matching;
+        }else if(++only > bound) {
+            return DBL_MAX;
+        }
+    }
+    
+    double d = (only + genes.size - matching) / n;
+    if(matching != 0) d += weight_coefficient * difference / matching;
+    return d;
+}
+
+struct ne_species {
+    // genes of the best member when the species was last formed
+    ne_genes representative;
+    
+    // indices into the population, in genome order
+    std::vector<size_t> members;
+    
+    // sum of the members' fitness over their number
+    double fitness;
+    
+    ne_species() : fitness(0.0) {}
+};
+
+#endif /* species_h */
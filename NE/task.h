@@ -0,0 +1,179 @@
+//
+//  task.h
+//  NE
+//
+//  Created by Arthur Sun on 9/30/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef task_h
+#define task_h
+
+#include "network.h"
+#include <string>
+#include <type_traits>
+
+// a task is a struct with static input_size, output_size, deterministic and name(), a float fitness, and
+// run(genome, p) that leaves the genome's fitness over one episode in fitness, printing the episode when p.
+// it may also have run(genome, streams, fitnesses, n) to play n episodes at once, episode q drawn from
+// streams[q]. tasks are only ever called through ne_task below, once per genome or per batch of episodes,
+// so the activations inside run() are plain calls on the task's own network
+
+// the loop of a task of I inputs and O outputs that steps one network through an episode. T provides reset()
+// to start an episode, observe(step, inputs, p) to fill in the inputs, false once the episode is over,
+// act(outputs, p) to apply the outputs, false to end the episode early, and finish() to turn what was
+// added to fitness into the result
+template <class T, size_t I, size_t O>
+struct ne_episode {
+    static const size_t input_size = I;
+    static const size_t output_size = O;
+    
+    float fitness;
+    
+    ne_network network;
+    
+    void run(ne_genome* gen, bool p) {
+        T& task = *static_cast<T*>(this);
+        
+        fitness = 0.0;
+        
+        task.reset();
+        network.compile(*gen);
+        
+        double* inputs = network.inputs();
+        const double* outputs = network.outputs();
+        
+        for(size_t step = 0; task.observe(step, inputs, p); ++step) {
+            network.activate<I, O>();
+            if(!task.act(outputs, p)) break;
+        }
+        
+        task.finish();
+    }
+};
+
+// whether T can play a batch of episodes itself
+template <class T>
+struct ne_batched {
+    template <class U>
+    static auto test(U* u) -> decltype(u->run((ne_genome*)nullptr, (const ne_rng*)nullptr, (float*)nullptr, (size_t)0), std::true_type());
+    
+    template <class U>
+    static std::false_type test(...);
+    
+    static const bool value = decltype(test<T>(nullptr))::value;
+};
+
+struct ne_task {
+    virtual ~ne_task() {}
+    
+    virtual const char* name() const = 0;
+    
+    virtual size_t input_size() const = 0;
+    
+    virtual size_t output_size() const = 0;
+    
+    // a genome always scores the same, so its fitness can be cached
+    virtual bool deterministic() const = 0;
+    
+    // fitness over one episode drawn from the calling thread's stream
+    virtual float evaluate(ne_genome* genome, bool p) = 0;
+    
+    // fitness over n episodes, episode q drawn from streams[q]
+    virtual void evaluate(ne_genome* genome, const ne_rng* streams, float* fitnesses, size_t n, bool p) = 0;
+    
+    // has the task's network run code, until given nullptr, instead of the genome it compiles
+    virtual void freeze(const ne_frozen* code) = 0;
+};
+
+template <class T>
+struct ne_task_of : ne_task {
+    T task;
+    
+    const char* name() const {
+        return T::name();
+    }
+    
+    size_t input_size() const {
+        return T::input_size;
+    }
+    
+    size_t output_size() const {
+        return T::output_size;
+    }
+    
+    bool deterministic() const {
+        return T::deterministic;
+    }
+    
+    float evaluate(ne_genome* genome, bool p) {
+        task.run(genome, p);
+        return task.fitness;
+    }
+    
+    void evaluate(ne_genome* genome, const ne_rng* streams, float* fitnesses, size_t n, bool p) {
+        evaluate(genome, streams, fitnesses, n, p, std::integral_constant<bool, ne_batched<T>::value>());
+    }
+    
+    // one episode at a time
+    void evaluate(ne_genome* genome, const ne_rng* streams, float* fitnesses, size_t n, bool p, std::false_type) {
+        for(size_t q = 0; q != n; ++q) {
+            ne_rng_scope scope(streams[q]);
+            task.run(genome, p);
+            fitnesses[q] = task.fitness;
+        }
+    }
+    
+    // all at once, unless they are to be printed, which only one at a time does
+    void evaluate(ne_genome* genome, const ne_rng* streams, float* fitnesses, size_t n, bool p, std::true_type) {
+        if(p) {
+            evaluate(genome, streams, fitnesses, n, p, std::false_type());
+        }else{
+            task.run(genome, streams, fitnesses, n);
+        }
+    }
+    
+    void freeze(const ne_frozen* code) {
+        task.network.freeze(code);
+    }
+};
+
+// tasks that can be chosen by name at runtime, with what is needed of them before any is made
+struct ne_task_entry {
+    const char* name;
+    size_t input_size;
+    size_t output_size;
+    bool deterministic;
+    ne_task* (*make)();
+};
+
+inline std::vector<ne_task_entry>& ne_task_registry() {
+    static std::vector<ne_task_entry> registry;
+    return registry;
+}
+
+template <class T>
+ne_task* ne_make_task() {
+    return new ne_task_of<T>();
+}
+
+template <class T>
+void ne_register_task() {
+    ne_task_registry().push_back({T::name(), T::input_size, T::output_size, T::deterministic, &ne_make_task<T>});
+}
+
+inline const ne_task_entry* ne_find_task(const std::string& name) {
+    for(const ne_task_entry& e : ne_task_registry()) {
+        if(name == e.name) return &e;
+    }
+    
+    return nullptr;
+}
+
+// a new instance of the task called name, or nullptr if there is none
+inline ne_task* ne_make_task(const std::string& name) {
+    const ne_task_entry* e = ne_find_task(name);
+    return e == nullptr ? nullptr : e->make();
+}
+
+#endif /* task_h */
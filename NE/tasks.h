@@ -0,0 +1,676 @@
+//
+//  tasks.h
+//  NE
+//
+//  Created by Arthur Sun on 9/29/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#ifndef tasks_h
+#define tasks_h
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <cstdlib>
+#include "task.h"
+#include "dataset.h"
+
+#define time_limit 1000
+
+#define time_step 0.01f
+
+struct Pendulum : ne_episode<Pendulum, 4, 1>
+{
+    static const bool deterministic = false;
+    
+    static const char* name() {
+        return "Pendulum";
+    }
+    
+    float x;
+    float vx;
+    float a;
+    float va;
+    
+    float g;
+    float m_c;
+    float m_p;
+    float m;
+    float l;
+    float f;
+    float b;
+    
+    float xt = 10.0;
+    
+    // the pole's angle as seen by the last observation
+    float c;
+    float s;
+    
+    std::vector<float> lx;
+    std::vector<float> lvx;
+    std::vector<float> la;
+    std::vector<float> lva;
+    std::vector<float> lc;
+    std::vector<float> ls;
+    std::vector<size_t> lane;
+    
+    Pendulum() {
+        g = 9.8;
+        m_c = 0.5;
+        m_p = 0.5;
+        m = m_c + m_p;
+        l = 0.6;
+        f = 20.0;
+        b = 0.1;
+    }
+    
+    void reset() {
+        x = ne_random(-2.0, 2.0);
+        vx = ne_random(-4.0, 4.0);
+        a = 0.1;
+        va = ne_random(-M_PI, M_PI);
+    }
+    
+    bool observe(size_t step, double* inputs, bool) {
+        if(step == time_limit) return false;
+        
+        c = cos(a);
+        s = sin(a);
+        
+        inputs[0] = 1.0;
+        inputs[1] = x / xt;
+        inputs[2] = c;
+        inputs[3] = s;
+        
+        return true;
+    }
+    
+    bool act(const double* outputs, bool p) {
+        float action = outputs[0] * 2.0 - 1.0;
+        
+        action *= f;
+        
+        float va2 = va * va;
+        float c2 = c * c;
+        
+        float vva = (g * m * s + c * (action - m_p * l * va2 * s - b * vx))/(l * (m - m_p * c2));
+        float vvx = (action + m_p * l * (vva * c - va2 * s) - b * vx) / m;
+        
+        vx = vx + vvx * time_step;
+        va = va + vva * time_step;
+        
+        x = x + vx * time_step;
+        a = a + va * time_step;
+        
+        if(x < -xt || x > xt)
+            return false;
+        
+        float f1 = fmax(cos(a), 0.0);
+        float f2 = (xt - fabs(x)) / xt;
+        
+        fitness += f1 + (f1 * f2);
+        
+        if(p) {
+            std::cout << x << ", " << a << ", " << '\n';
+        }
+        
+        return true;
+    }
+    
+    void finish() {
+        fitness /= 2000.0;
+    }
+    
+    using ne_episode<Pendulum, 4, 1>::run;
+    
+    // n episodes of one genome stepped in lockstep, episode q starting from streams[q].
+    // state is kept as structure of arrays and carts that leave the track are swapped out of the live range
+    void run(ne_genome* gen, const ne_rng* streams, float* fitnesses, size_t n) {
+        network.compile(*gen);
+        network.flush(n);
+        
+        lx.resize(n);
+        lvx.resize(n);
+        la.resize(n);
+        lva.resize(n);
+        lc.resize(n);
+        ls.resize(n);
+        lane.resize(n);
+        
+        for(size_t q = 0; q != n; ++q) {
+            ne_rng_scope scope(streams[q]);
+            reset();
+            
+            lx[q] = x;
+            lvx[q] = vx;
+            la[q] = a;
+            lva[q] = va;
+            lane[q] = q;
+            
+            fitnesses[q] = 0.0;
+        }
+        
+        double* bias = network.row(0);
+        double* position = network.row(1);
+        double* cosine = network.row(2);
+        double* sine = network.row(3);
+        double* outputs = network.row(network.size() - output_size);
+        
+        size_t live = n;
+        
+        for(int i = 0; i < time_limit && live != 0; ++i) {
+            for(size_t q = 0; q != live; ++q) {
+                lc[q] = cos(la[q]);
+                ls[q] = sin(la[q]);
+                
+                bias[q] = 1.0;
+                position[q] = lx[q] / xt;
+                cosine[q] = lc[q];
+                sine[q] = ls[q];
+            }
+            
+            network.step<input_size, output_size>(live);
+            
+            for(size_t q = 0; q != live; ++q) {
+                float c = lc[q];
+                float s = ls[q];
+                
+                float action = outputs[q] * 2.0 - 1.0;
+                
+                action *= f;
+                
+                float va2 = lva[q] * lva[q];
+                float c2 = c * c;
+                
+                float vva = (g * m * s + c * (action - m_p * l * va2 * s - b * lvx[q]))/(l * (m - m_p * c2));
+                float vvx = (action + m_p * l * (vva * c - va2 * s) - b * lvx[q]) / m;
+                
+                lvx[q] = lvx[q] + vvx * time_step;
+                lva[q] = lva[q] + vva * time_step;
+                
+                lx[q] = lx[q] + lvx[q] * time_step;
+                la[q] = la[q] + lva[q] * time_step;
+            }
+            
+            for(size_t q = 0; q < live;) {
+                if(lx[q] < -xt || lx[q] > xt) {
+                    --live;
+                    
+                    lx[q] = lx[live];
+                    lvx[q] = lvx[live];
+                    la[q] = la[live];
+                    lva[q] = lva[live];
+                    lane[q] = lane[live];
+                    
+                    network.move_lane(live, q);
+                    continue;
+                }
+                
+                float f1 = fmax(cos(la[q]), 0.0);
+                float f2 = (xt - fabs(lx[q])) / xt;
+                
+                fitnesses[lane[q]] += f1 + (f1 * f2);
+                ++q;
+            }
+        }
+        
+        for(size_t q = 0; q != n; ++q)
+            fitnesses[q] /= 2000.0;
+    }
+    
+};
+
+
+struct XOR
+{
+    static const size_t input_size = 3;
+    static const size_t output_size = 1;
+    static const bool deterministic = true;
+    
+    static const char* name() {
+        return "XOR";
+    }
+    
+    float fitness;
+    
+    ne_network network;
+    
+    void run(ne_genome* gen, bool p) {
+        fitness = 0.0;
+        
+        network.compile(*gen);
+        
+        double inputs[4 * input_size];
+        double outputs[4 * output_size];
+        
+        for(int a = 0; a < 2; ++a) {
+            for(int b = 0; b < 2; ++b) {
+                double* in = inputs + (a * 2 + b) * input_size;
+                
+                in[0] = 1.0;
+                in[1] = a;
+                in[2] = b;
+            }
+        }
+        
+        network.activate<input_size, output_size>(inputs, outputs, 4);
+        
+        for(int a = 0; a < 2; ++a) {
+            for(int b = 0; b < 2; ++b) {
+                int c = a ^ b;
+                
+                double* out = outputs + (a * 2 + b) * output_size;
+                
+                float d = out[0] - c;
+                fitness += 1.0 - d * d;
+                
+                if(p) {
+                    std::cout << out[0] << '\n';
+                }
+            }
+        }
+        
+        fitness *= 0.25;
+    }
+};
+
+struct Game2048 : ne_episode<Game2048, 17, 4>
+{
+    static const bool deterministic = false;
+    
+    static const char* name() {
+        return "Game2048";
+    }
+    
+    // 16 cells of 4 bits, cell (x, y) at bits 4 * (x + y * 4), holding the exponent of the tile (0 when empty)
+    uint64_t board;
+    
+    // every 16 bit row moved left and right; columns are read top to bottom into a row, so moving one up is
+    // moving that row left, and up/down hold the result already spread back out to one nibble per board row
+    struct Tables {
+        uint16_t left[0x10000];
+        uint16_t right[0x10000];
+        uint64_t up[0x10000];
+        uint64_t down[0x10000];
+        uint32_t score_left[0x10000];
+        uint32_t score_right[0x10000];
+        
+        Tables() {
+            for(uint32_t r = 0; r != 0x10000; ++r) {
+                size_t row[4];
+                
+                for(int x = 0; x < 4; ++x)
+                    row[x] = (r >> (4 * x)) & 0xf;
+                score_left[r] = slide(row);
+                left[r] = pack(row);
+                up[r] = spread(left[r]);
+                
+                for(int x = 0; x < 4; ++x)
+                    row[3 - x] = (r >> (4 * x)) & 0xf;
+                score_right[r] = slide(row);
+                std::reverse(row, row + 4);
+                right[r] = pack(row);
+                down[r] = spread(right[r]);
+            }
+        }
+        
+        // moves a row of exponents to the left, returns the score of the merges
+        static uint32_t slide(size_t* row) {
+            uint32_t score = 0;
+            for(int x = 0; x < 4; ++x) {
+                size_t v1 = row[x];
+                if(v1 == 0) continue;
+                
+                for(int i = x + 1; i < 4; ++i) {
+                    size_t v2 = row[i];
+                    if(v1 == v2) {
+                        score += 2u << v1;
+                        
+                        // a nibble can't hold 65536, so two 32768 tiles still merge and score but stay at 32768
+                        if(v1 != 0xf) ++row[x];
+                        row[i] = 0;
+                        
+                        break;
+                    }else if(v2 != 0) {
+                        break;
+                    }
+                }
+                
+                int l = x;
+                while(l != 0 && row[l - 1] == 0) {
+                    row[l - 1] = row[l];
+                    row[l] = 0;
+                    --l;
+                }
+            }
+            return score;
+        }
+        
+        static uint16_t pack(const size_t* row) {
+            return row[0] | (row[1] << 4) | (row[2] << 8) | (row[3] << 12);
+        }
+        
+        static uint64_t spread(uint64_t row) {
+            return (row & 0xf) | ((row & 0xf0) << 12) | ((row & 0xf00) << 24) | ((row & 0xf000) << 36);
+        }
+    };
+    
+    static const Tables& tables() {
+        static const Tables* t = new Tables();
+        return *t;
+    }
+    
+    inline size_t get(int x, int y) const {
+        size_t e = (board >> (4 * (x + y * 4))) & 0xf;
+        return e == 0 ? 0 : (size_t)1 << e;
+    }
+    
+    void reset() {
+        board = 0;
+        
+        add2();
+    }
+    
+    // nonzero nibble becomes 1 in the lowest bit of the nibble
+    static inline uint64_t occupied(uint64_t b) {
+        return (b | (b >> 1) | (b >> 2) | (b >> 3)) & 0x1111111111111111;
+    }
+    
+    void add2() {
+        uint64_t empty = ~occupied(board) & 0x1111111111111111;
+        
+        uint64_t tile = ne_random(0.0, 1.0) < 0.9 ? 1 : 2;
+        size_t k = ne_random(0lu, (size_t)__builtin_popcountll(empty) - 1);
+        
+        while(k-- != 0)
+            empty &= empty - 1;
+        
+        board |= tile << __builtin_ctzll(empty);
+    }
+    
+    static inline uint16_t column(uint64_t b, int x) {
+        uint64_t c = (b >> (4 * x)) & 0x000f000f000f000f;
+        return (c | (c >> 12) | (c >> 24) | (c >> 36)) & 0xffff;
+    }
+    
+    size_t move_left(bool& moved) {
+        const Tables& t = tables();
+        uint64_t result = 0;
+        size_t score = 0;
+        for(int y = 0; y < 4; ++y) {
+            uint16_t r = (board >> (16 * y)) & 0xffff;
+            result |= (uint64_t)t.left[r] << (16 * y);
+            score += t.score_left[r];
+        }
+        moved = result != board;
+        board = result;
+        return score;
+    }
+    
+    size_t move_right(bool& moved) {
+        const Tables& t = tables();
+        uint64_t result = 0;
+        size_t score = 0;
+        for(int y = 0; y < 4; ++y) {
+            uint16_t r = (board >> (16 * y)) & 0xffff;
+            result |= (uint64_t)t.right[r] << (16 * y);
+            score += t.score_right[r];
+        }
+        moved = result != board;
+        board = result;
+        return score;
+    }
+    
+    size_t move_up(bool& moved) {
+        const Tables& t = tables();
+        uint64_t result = 0;
+        size_t score = 0;
+        for(int x = 0; x < 4; ++x) {
+            uint16_t c = column(board, x);
+            result |= t.up[c] << (4 * x);
+            score += t.score_left[c];
+        }
+        moved = result != board;
+        board = result;
+        return score;
+    }
+    
+    size_t move_down(bool& moved) {
+        const Tables& t = tables();
+        uint64_t result = 0;
+        size_t score = 0;
+        for(int x = 0; x < 4; ++x) {
+            uint16_t c = column(board, x);
+            result |= t.down[c] << (4 * x);
+            score += t.score_right[c];
+        }
+        moved = result != board;
+        board = result;
+        return score;
+    }
+    
+    // -1 while a cell is empty, 0 while two neighbours match, 1 once no move is left
+    int get_move() const {
+        if(occupied(board) != 0x1111111111111111) return -1;
+        
+        uint64_t h = occupied(board ^ (board >> 4)) | 0x1000100010001000;
+        uint64_t v = occupied(board ^ (board >> 16)) | 0x1111000000000000;
+        
+        if((h & v) != 0x1111111111111111) return 0;
+        
+        return 1;
+    }
+    
+    void print() {
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                std::cout << std::setw(5) << get(x, y) << " ";
+            }
+            
+            std::cout << '\n';
+        }
+    }
+    
+    bool observe(size_t, double* inputs, bool p) {
+        int m = get_move();
+        
+        if(p) {
+            print();
+            std::cout << '\n';
+        }
+        
+        if(m == 1) return false;
+        
+        inputs[0] = 1.0;
+        for(int i = 0; i < 16; ++i) {
+            inputs[i + 1] = get(i & 3, i >> 2);
+        }
+        
+        network.flush();
+        return true;
+    }
+    
+    bool act(const double* outputs, bool p) {
+        int choices[4] = {0, 1, 2, 3};
+        
+        std::sort(choices, choices + 4, [=] (int a, int b) {
+            return outputs[a] > outputs[b];
+        });
+        
+        bool moved = false;
+        
+        size_t i = 0;
+        while(!moved) {
+            int c = choices[i];
+            if(c == 0) {
+                fitness += move_up(moved);
+                if(p) std::cout << "up" << '\n';
+            }else if(c == 1) {
+                fitness += move_down(moved);
+                if(p) std::cout << "down" << '\n';
+            }else if(c == 2) {
+                fitness += move_left(moved);
+                if(p) std::cout << "left" << '\n';
+            }else{
+                fitness += move_right(moved);
+                if(p) std::cout << "right" << '\n';
+            }
+            ++i;
+        }
+        
+        add2();
+        return true;
+    }
+    
+    void finish() {}
+};
+
+struct DIR
+{
+    static const size_t input_size = 2;
+    static const size_t output_size = 2;
+    static const bool deterministic = true;
+    
+    static const char* name() {
+        return "DIR";
+    }
+    
+    float fitness;
+    
+    ne_network network;
+    
+    void run(ne_genome* gen, bool) {
+        fitness = 0.0;
+        
+        network.compile(*gen);
+        
+        const size_t q = 200;
+        
+        double inputs[q * input_size];
+        double outputs[q * output_size];
+        
+        float a = 0.0;
+        for(size_t n = 0; n < q; ++n) {
+            inputs[n * input_size + 0] = 1.0;
+            inputs[n * input_size + 1] = a;//ne_random(-10.0, 10.0);
+            
+            a += 0.05;
+        }
+        
+        network.activate<input_size, output_size>(inputs, outputs, q);
+        
+        a = 0.0;
+        float d;
+        for(size_t n = 0; n < q; ++n) {
+            double* out = outputs + n * output_size;
+            
+            d = out[0] - cos(a);
+            fitness += (1.0 - d * d) * 0.5;
+            
+            d = out[1] - sin(a);
+            fitness += (1.0 - d * d) * 0.5;
+            
+            a += 0.05;
+        }
+        
+        fitness /= (float) q;
+    }
+};
+
+struct HANDDIGITS
+{
+    static const size_t input_size = 28 * 28 + 1;
+    static const size_t output_size = 10;
+    static const bool deterministic = false;
+    
+    static const char* name() {
+        return "HANDDIGITS";
+    }
+    
+    float fitness;
+    
+    const ne_dataset& data;
+    
+    ne_network network;
+    
+    // mapped once and shared by every task object
+    static const ne_dataset& dataset() {
+        static const ne_dataset* d = [] {
+            ne_dataset* d = new ne_dataset();
+            
+            if(!d->open("train-images-idx3-ubyte", "train-labels-idx1-ubyte") || d->count == 0 || d->pixels() + 1 != input_size) {
+                std::cerr << "can't read 28x28 images from train-images-idx3-ubyte and train-labels-idx1-ubyte" << '\n';
+                exit(1);
+            }
+            
+            return d;
+        }();
+        
+        return *d;
+    }
+    
+    HANDDIGITS() : data(dataset()) {}
+    
+    void run(ne_genome* gen, bool p) {
+        fitness = 0.0;
+        
+        network.compile(*gen);
+        
+        const int trials = 100;
+        int correct = 0;
+        
+        int samples[trials];
+        
+        network.flush(trials);
+        std::fill(network.row(0), network.row(0) + trials, 1.0);
+        
+        for(int n = 0; n < trials; ++n) {
+            int i = (int)ne_random(0, (int)data.count - 1);
+            data.load(i, network.row(1) + n, trials);
+            samples[n] = i;
+        }
+        
+        network.step<input_size, output_size>(trials);
+        
+        const double* outputs = network.row(network.size() - output_size);
+        
+        for(int n = 0; n < trials; ++n) {
+            int label = data.label(samples[n]);
+            
+            int h = 0;
+            for(int j = 0; j < 10; ++j) {
+                float expected = label == j ? 1.0 : 0.0;
+                float d = outputs[j * trials + n] - expected;
+                fitness += (1.0 - d * d) * 0.1;
+                
+                if(outputs[j * trials + n] > outputs[h * trials + n])
+                    h = j;
+                
+                if(p) std::cout << outputs[j * trials + n] << " ";
+            }
+            
+            if(p) std::cout << "label: " << label << '\n';
+            
+            if(h == label) ++correct;
+        }
+        
+        fitness = correct;
+    }
+};
+
+// makes the tasks above known to ne_make_task(), once
+inline void ne_register_tasks() {
+    static bool registered = [] {
+        ne_register_task<Pendulum>();
+        ne_register_task<XOR>();
+        ne_register_task<Game2048>();
+        ne_register_task<DIR>();
+        ne_register_task<HANDDIGITS>();
+        return true;
+    }();
+    
+    (void)registered;
+}
+
+#endif /* tasks_h */
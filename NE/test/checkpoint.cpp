@@ -0,0 +1,150 @@
+//
+//  checkpoint.cpp
+//  NE test
+//
+//  Created by Arthur Sun on 10/2/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#include <sstream>
+#include "../population.h"
+
+// a population with species written and read back must write the same bytes and evolve the same way,
+// and no corrupted or truncated copy of it may read back as good or throw
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(ok) return;
+    std::cerr << "failed: " << what << '\n';
+    ++failures;
+}
+
+// a fitness that depends on nothing but the genome, so two copies evolve alike
+void score(ne_population& population) {
+    for(ne_genome* g : population.genomes)
+        g->fitness = (double)(ne_mix(g->hash()) % 1000) / 1000.0;
+    
+    population.analyse();
+}
+
+void evolve(ne_population& population, int generations) {
+    for(int n = 0; n < generations; ++n) {
+        score(population);
+        population.reproduce();
+    }
+    
+    score(population);
+}
+
+std::string pack(const ne_population& population) {
+    std::ostringstream os;
+    ne_writer w(os);
+    population.write(w);
+    w.close();
+    return os.str();
+}
+
+// whether data reads back whole, without letting an exception out
+bool readable(const std::string& data) {
+    try {
+        std::istringstream is(data);
+        ne_reader r(is);
+        ne_population population(r);
+        return r.good;
+    }catch(const std::exception& e) {
+        check(false, std::string("reading threw ") + e.what());
+        return false;
+    }
+}
+
+int main() {
+    ne_reseed(1);
+    
+    ne_settings settings(0.1, 0.5, 60);
+    settings.seed = 1;
+    settings.task = "XOR";
+    
+    ne_population population(settings, 3, 1);
+    evolve(population, 30);
+    
+    check(!population.species.empty(), "species formed");
+    
+    std::string data = pack(population);
+    
+    {
+        std::istringstream is(data);
+        ne_reader r(is);
+        ne_population copy(r);
+        
+        check(r.good, "round trip reads back");
+        
+        if(r.good) {
+            check(pack(copy) == data, "round trip writes the same bytes");
+            
+            evolve(population, 10);
+            evolve(copy, 10);
+            check(pack(copy) == pack(population), "round trip evolves the same way");
+        }
+    }
+    
+    size_t corrupt = 0;
+    for(size_t k = 0; k != data.size(); ++k) {
+        std::string bad = data;
+        bad[k] ^= 0x5a;
+        if(readable(bad)) ++corrupt;
+    }
+    
+    check(corrupt == 0, std::to_string(corrupt) + " corrupted copies read back as good");
+    
+    size_t truncated = 0;
+    for(size_t k = 0; k < data.size(); k += 8) {
+        if(readable(data.substr(0, k))) ++truncated;
+    }
+    
+    check(truncated == 0, std::to_string(truncated) + " truncated copies read back as good");
+    
+    // a species count far past the end of the record, with the checksum left as it was
+    {
+        std::string bad = data;
+        size_t settings_words = 1 + 20 + ne_text_words(settings.task) + 1;
+        uint64_t count = ~(uint64_t)0 >> 8;
+        memcpy(&bad[(3 + settings_words + 1) * sizeof(uint64_t)], &count, sizeof(count));
+        check(!readable(bad), "a huge species count is refused");
+    }
+    
+    // well framed genomes that would send a network outside its nodes
+    {
+        ne_genome shapes[4] = {ne_genome(3, 1), ne_genome(3, 1), ne_genome(3, 1), ne_genome(3, 1)};
+        ne_link links[3] = {ne_link(0, 4), ne_link(7, 3), ne_link(0, 1)};
+        
+        // a target past the nodes, a source past the nodes, a link into an input, and fewer nodes than
+        // inputs and outputs
+        for(size_t k = 0; k != 3; ++k) {
+            links[k].weight = 1.0;
+            shapes[k].add(links[k]);
+        }
+        
+        shapes[3].node_size = 3;
+        
+        for(size_t k = 0; k != 4; ++k) {
+            std::ostringstream os;
+            
+            {
+                ne_writer w(os);
+                shapes[k].write(w);
+                w.close();
+            }
+            
+            std::istringstream is(os.str());
+            ne_reader r(is);
+            ne_genome g(r);
+            
+            check(!r.good, "malformed genome " + std::to_string(k) + " is refused");
+        }
+    }
+    
+    std::cout << (failures == 0 ? "ok" : "FAILED") << '\n';
+    
+    return failures == 0 ? 0 : 1;
+}
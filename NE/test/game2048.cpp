@@ -0,0 +1,291 @@
+//
+//  game2048.cpp
+//  NE test
+//
+//  Created by Arthur Sun on 10/3/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#include "../tasks.h"
+
+// the packed board and its move tables must play exactly as the grid of tile values they replaced, row by row
+// and column by column, except that two 32768 tiles merge into a 32768 a nibble can still hold
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(ok) return;
+    if(failures < 20) std::cerr << "failed: " << what << '\n';
+    ++failures;
+}
+
+// the grid of tile values and the loops that moved it, as they were before the tables
+struct Reference {
+    size_t grid[16];
+    
+    inline size_t& get(int x, int y) {
+        return grid[x + y * 4];
+    }
+    
+    size_t move_left(bool& moved) {
+        size_t score = 0;
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                size_t v1 = get(x, y);
+                if(v1 == 0) continue;
+                
+                for(int i = x + 1; i < 4; ++i) {
+                    size_t v2 = get(i, y);
+                    if(v1 == v2) {
+                        score += v1 + v2;
+                        moved = true;
+                        
+                        get(x, y) += get(i, y);
+                        get(i, y) = 0;
+                        
+                        break;
+                    }else if(v1 != v2 && v2 != 0) {
+                        break;
+                    }
+                }
+                
+                int l = x;
+                while(l != 0 && get(l - 1, y) == 0) {
+                    get(l - 1, y) = get(l, y);
+                    get(l, y) = 0;
+                    --l;
+                    
+                    moved = true;
+                }
+            }
+        }
+        return score;
+    }
+    
+    size_t move_right(bool& moved) {
+        size_t score = 0;
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 3; x >= 0; --x) {
+                size_t v1 = get(x, y);
+                if(v1 == 0) continue;
+                
+                for(int i = x - 1; i >= 0; --i) {
+                    size_t v2 = get(i, y);
+                    if(v1 == v2) {
+                        score += v1 + v2;
+                        moved = true;
+                        
+                        get(x, y) += get(i, y);
+                        get(i, y) = 0;
+                        
+                        break;
+                    }else if(v1 != v2 && v2 != 0) {
+                        break;
+                    }
+                }
+                
+                int r = x;
+                while(r != 3 && get(r + 1, y) == 0) {
+                    get(r + 1, y) = get(r, y);
+                    get(r, y) = 0;
+                    ++r;
+                    
+                    moved = true;
+                }
+            }
+        }
+        return score;
+    }
+    
+    size_t move_up(bool& moved) {
+        size_t score = 0;
+        for(int x = 0; x < 4; ++x) {
+            for(int y = 0; y < 4; ++y) {
+                size_t v1 = get(x, y);
+                if(v1 == 0) continue;
+                
+                for(int i = y + 1; i < 4; ++i) {
+                    size_t v2 = get(x, i);
+                    if(v1 == v2) {
+                        score += v1 + v2;
+                        moved = true;
+                        
+                        get(x, y) += get(x, i);
+                        get(x, i) = 0;
+                        
+                        break;
+                    }else if(v1 != v2 && v2 != 0) {
+                        break;
+                    }
+                }
+                
+                int u = y;
+                while(u != 0 && get(x, u - 1) == 0) {
+                    get(x, u - 1) = get(x, u);
+                    get(x, u) = 0;
+                    --u;
+                    
+                    moved = true;
+                }
+            }
+        }
+        return score;
+    }
+    
+    size_t move_down(bool& moved) {
+        size_t score = 0;
+        for(int x = 0; x < 4; ++x) {
+            for(int y = 3; y >= 0; --y) {
+                size_t v1 = get(x, y);
+                if(v1 == 0) continue;
+                
+                for(int i = y - 1; i >= 0; --i) {
+                    size_t v2 = get(x, i);
+                    if(v1 == v2) {
+                        score += v1 + v2;
+                        moved = true;
+                        
+                        get(x, y) += get(x, i);
+                        get(x, i) = 0;
+                        
+                        break;
+                    }else if(v1 != v2 && v2 != 0) {
+                        break;
+                    }
+                }
+                
+                int d = y;
+                while(d != 3 && get(x, d + 1) == 0) {
+                    get(x, d + 1) = get(x, d);
+                    get(x, d) = 0;
+                    ++d;
+                    
+                    moved = true;
+                }
+            }
+        }
+        return score;
+    }
+    
+    int get_move() {
+        for(int i = 0; i < 16; ++i) {
+            if(grid[i] == 0) return -1;
+        }
+        
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                if(x != 3 && get(x + 1, y) == get(x, y)) {
+                    return 0;
+                }
+                if(y != 3 && get(x, y + 1) == get(x, y)) {
+                    return 0;
+                }
+            }
+        }
+        
+        return 1;
+    }
+    
+    void load(uint64_t board) {
+        for(int k = 0; k < 16; ++k) {
+            size_t e = (board >> (4 * k)) & 0xf;
+            grid[k] = e == 0 ? 0 : (size_t)1 << e;
+        }
+    }
+    
+    // 65536, which only two 32768 tiles make, saturates at 32768
+    uint64_t pack() const {
+        uint64_t board = 0;
+        
+        for(int k = 0; k < 16; ++k) {
+            size_t e = grid[k] == 0 ? 0 : std::min(__builtin_ctzll(grid[k]), 15);
+            board |= (uint64_t)e << (4 * k);
+        }
+        
+        return board;
+    }
+};
+
+// board moved in direction d both ways, which must agree on the board, the score and whether it moved
+void compare(uint64_t board, int d, const char* name) {
+    Game2048 game;
+    Reference reference;
+    
+    game.board = board;
+    reference.load(board);
+    
+    bool moved = false;
+    bool reference_moved = false;
+    size_t score = 0;
+    size_t reference_score = 0;
+    
+    switch(d) {
+        case 0: score = game.move_left(moved); reference_score = reference.move_left(reference_moved); break;
+        case 1: score = game.move_right(moved); reference_score = reference.move_right(reference_moved); break;
+        case 2: score = game.move_up(moved); reference_score = reference.move_up(reference_moved); break;
+        default: score = game.move_down(moved); reference_score = reference.move_down(reference_moved); break;
+    }
+    
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)board);
+    
+    check(game.board == reference.pack() && score == reference_score && moved == reference_moved, std::string(name) + " of " + hex);
+}
+
+int main() {
+    ne_reseed(1);
+    
+    // every row in every row of the board for left and right, and as every column for up and down
+    for(uint64_t r = 0; r != 0x10000; ++r) {
+        for(int k = 0; k < 4; ++k) {
+            compare(r << (16 * k), 0, "left");
+            compare(r << (16 * k), 1, "right");
+            
+            uint64_t column = Game2048::Tables::spread(r) << (4 * k);
+            compare(column, 2, "up");
+            compare(column, 3, "down");
+        }
+    }
+    
+    // two 32768 tiles score 65536 and leave one 32768
+    {
+        Game2048 game;
+        game.board = 0xff;
+        bool moved = false;
+        size_t score = game.move_left(moved);
+        check(game.board == 0xf && score == 65536 && moved, "32768 + 32768 saturates");
+    }
+    
+    // full boards: random ones, which nearly always have a pair left, and ones built with no pair at all;
+    // each also with one cell emptied
+    for(int n = 0; n < 200000; ++n) {
+        uint64_t board = 0;
+        
+        for(int k = 0; k < 16; ++k) {
+            uint64_t e;
+            
+            do {
+                e = ne_random(1, n < 100000 ? 3 : 15);
+            }while(n >= 100000 && ((k % 4 != 0 && e == ((board >> (4 * (k - 1))) & 0xf)) || (k >= 4 && e == ((board >> (4 * (k - 4))) & 0xf))));
+            
+            board |= e << (4 * k);
+        }
+        
+        for(int d = 0; d < 4; ++d)
+            compare(board, d, "move of a full board");
+        
+        for(uint64_t b : {board, board & ~((uint64_t)0xf << (4 * (n % 16)))}) {
+            Game2048 game;
+            Reference reference;
+            
+            game.board = b;
+            reference.load(b);
+            
+            check(game.get_move() == reference.get_move(), "get_move");
+        }
+    }
+    
+    std::cout << (failures == 0 ? "ok" : "FAILED") << '\n';
+    
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+//
+//  main.cpp
+//  NE worker
+//
+//  Created by Arthur Sun on 9/29/19.
+//  Copyright © 2019 Arthur Sun. All rights reserved.
+//
+
+#include "../tasks.h"
+#include "../farm.h"
+
+// stand-in for an external simulator: evaluates batches from an ne_farm on stdin and stdout
+// with one of the registered tasks, named by the first argument
+
+int main(int argc, const char * argv[]) {
+    std::string task = argc > 1 ? argv[1] : "";
+    
+    // the tasks print to std::cout when asked, which would corrupt the answers
+    std::cout.rdbuf(std::cerr.rdbuf());
+    
+    ne_register_tasks();
+    
+    if(ne_find_task(task) != nullptr) return ne_serve(task, 0, 1);
+    
+    std::cerr << "unknown task: " << task << '\n';
+    return 1;
+}